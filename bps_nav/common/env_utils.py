@@ -30,8 +30,11 @@ class Sync:
         self._envs.wait_for_frame(self._idx)
 
 def construct_envs(
-    config, num_worker_groups: int = 4, double_buffered: bool = True,
+    config, num_worker_groups: int = 4, double_buffered: bool = True, rollouts=None,
 ):
+    r"""Creates the batch simulator. When rollouts is given, each group writes
+    its step results straight into that group's rollout storage host buffers.
+    """
     import bps_sim 
     import bps_pytorch
 
@@ -115,6 +118,17 @@ def construct_envs(
         infos.append(info)
         syncs.append(Sync(envs, i))
 
+        if rollouts is not None:
+            rollouts[i].make_host_buffers(packed_info.dtype)
+            host_buffers = rollouts[i].host_buffers
+            envs.register_rollout_buffers(
+                i,
+                host_buffers["rewards"].numpy(),
+                host_buffers["masks"].numpy(),
+                host_buffers["infos"],
+                host_buffers["polars"].numpy(),
+            )
+
     return (envs, observations, rewards, masks, infos, syncs)
 
 
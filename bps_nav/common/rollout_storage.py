@@ -23,6 +23,7 @@ from bps_nav.common.tree_utils import (
     tree_copy_in_place,
     tree_indexed_copy_in_place,
     tree_multi_map,
+    tree_flatten,
 )
 
 
@@ -106,6 +107,7 @@ class RolloutStorage:
 
         self.num_steps = num_steps
         self.step = 0
+        self.host_buffers = None
 
     def to(self, device):
         self.device = device
@@ -127,6 +129,47 @@ class RolloutStorage:
     def share_memory(self):
         tree_map_in_place(lambda v: v.share_memory_(), self.storage_buffers)
 
+    def make_host_buffers(self, info_dtype):
+        r"""Allocates the pinned [num_steps + 1, num_envs] host buffers that
+        RolloutGenerator.register_rollout_buffers has the simulator write its
+        step results into. info_dtype is the dtype of the simulator's infos.
+        """
+        num_slots = self.num_steps + 1
+        num_envs = self.storage_buffers["rewards"].size(1)
+
+        infos = torch.zeros(
+            num_slots, num_envs * info_dtype.itemsize, dtype=torch.uint8
+        ).pin_memory()
+
+        self.host_buffers = dict(
+            rewards=torch.zeros(num_slots, num_envs).pin_memory(),
+            masks=torch.zeros(num_slots, num_envs, dtype=torch.uint8).pin_memory(),
+            infos=infos.numpy().view(info_dtype),
+            polars=torch.zeros(num_slots, num_envs, 2).pin_memory(),
+        )
+
+    def host_step_results(self):
+        r"""The rewards, masks, infos and pointgoals the simulator wrote for the
+        current step, as views of the host buffers
+        """
+        infos = self.host_buffers["infos"][self.step]
+
+        return (
+            self.host_buffers["rewards"][self.step].view(-1, 1),
+            self.host_buffers["masks"][self.step + 1].view(-1, 1),
+            {k: torch.from_numpy(infos[k]).view(-1, 1) for k in infos.dtype.names},
+            self.host_buffers["polars"][self.step + 1],
+        )
+
+    def copy_host_rewards(self):
+        r"""Copies the rewards of the steps so far over from the host buffers,
+        once per rollout rather than once per step
+        """
+        self.storage_buffers["rewards"][: self.step].copy_(
+            self.host_buffers["rewards"][: self.step].unsqueeze(-1),
+            non_blocking=True,
+        )
+
     def insert(
         self,
         observations=None,
@@ -201,29 +244,20 @@ class RolloutStorage:
         self.step = 0
 
     def compute_returns(self, next_value, use_gae, gamma, tau):
-        if use_gae:
-            self.storage_buffers["value_preds"][self.step] = next_value
-
-            value_preds = self.storage_buffers["value_preds"]
-            rewards = self.storage_buffers["rewards"]
-            returns = self.storage_buffers["returns"]
-            masks = self.storage_buffers["masks"]
-            gae = 0
-            for step in reversed(range(self.step)):
-                delta = (
-                    rewards[step]
-                    + gamma * value_preds[step + 1] * masks[step + 1]
-                    - value_preds[step]
-                )
-                gae = delta + gamma * tau * gae * masks[step + 1]
-                returns[step] = gae + value_preds[step]
-        else:
-            self.returns[self.step] = next_value
-            for step in reversed(range(self.step)):
-                self.returns[step] = (
-                    self.returns[step + 1] * gamma * self.masks[step + 1]
-                    + self.rewards[step]
-                )
+        import bps_pytorch
+
+        self.storage_buffers["value_preds"][self.step] = next_value
+
+        # Without GAE these are the plain discounted returns, which GAE
+        # gives for tau = 1
+        returns = bps_pytorch.compute_gae_returns(
+            self.storage_buffers["rewards"][: self.step],
+            self.storage_buffers["value_preds"][: self.step + 1],
+            self.storage_buffers["masks"][: self.step + 1],
+            gamma,
+            tau if use_gae else 1.0,
+        )
+        self.storage_buffers["returns"][: self.step].copy_(returns)
 
     def recurrent_generator(self, advantages, num_mini_batch):
         num_processes = advantages.size(1)
@@ -290,6 +324,7 @@ class DoubleBufferedRolloutStorage:
             )
             for _ in range(nbuffers)
         ]
+        self._minibatch_arenas = {}
 
     def to(self, device):
         for buf in self.buffers:
@@ -316,7 +351,31 @@ class DoubleBufferedRolloutStorage:
     def __len__(self):
         return len(self.buffers)
 
+    def _minibatch_arena(self, sources, num_envs, device):
+        r"""The output tensors minibatches of num_envs envs are gathered into,
+        allocated once and reused for every later minibatch of that size
+        """
+        key = (num_envs, str(device), self.step)
+        if key not in self._minibatch_arenas:
+
+            def _alloc(parts, num_steps=self.step):
+                return torch.empty(
+                    (min(num_steps, parts[0].size(0)), num_envs, *parts[0].size()[2:]),
+                    dtype=parts[0].dtype,
+                    device=device,
+                )
+
+            arena = tree_map(_alloc, sources)
+            arena["recurrent_hidden_states"] = _alloc(
+                sources["recurrent_hidden_states"], num_steps=1
+            )
+            self._minibatch_arenas[key] = arena
+
+        return self._minibatch_arenas[key]
+
     def recurrent_generator(self, advantages, num_mini_batch, timing, device=None):
+        import bps_pytorch
+
         num_processes = advantages.size(1)
         nbuffers = len(self.buffers)
 
@@ -327,7 +386,7 @@ class DoubleBufferedRolloutStorage:
         )
 
         if device is None:
-            device = self.buffers[0].rewards.device
+            device = self.buffers[0].storage_buffers["rewards"].device
 
         self.step = self[0].step
         for idx in range(nbuffers):
@@ -338,40 +397,21 @@ class DoubleBufferedRolloutStorage:
         if self.vtrace:
             self.step += 1
 
+        # Each field's tensors in env order, the advantages already span all
+        # the buffers
+        sources = tree_multi_map(
+            lambda *parts: list(parts),
+            self[0].storage_buffers,
+            *(buf.storage_buffers for buf in self.buffers[1:]),
+        )
+        sources["advantages"] = [advantages.contiguous()]
+        source_leaves = tree_flatten(sources)
+
         for mb_inds in torch.randperm(num_processes).chunk(num_mini_batch):
             with timing.add_time("Generate-Mini-Batch"):
-                adv_inds = []
-                inds_for_buffer = [[] for _ in range(nbuffers)]
-
-                for ind in mb_inds:
-                    adv_inds.append(ind)
-
-                    buffer_ind = ind // (num_processes // nbuffers)
-                    env_ind = ind % (num_processes // nbuffers)
+                mb = self._minibatch_arena(sources, len(mb_inds), device)
+                bps_pytorch.gather_minibatch(source_leaves, mb_inds, tree_flatten(mb))
 
-                    inds_for_buffer[buffer_ind].append(env_ind)
-
-                mbs = []
-                for i in range(nbuffers):
-                    mbs.append(
-                        tree_select(
-                            (slice(self.step), inds_for_buffer[i]),
-                            self[i].storage_buffers,
-                        )
-                    )
-                if nbuffers == 1:
-                    mb = mbs[0]
-                else:
-                    mb = tree_multi_map(
-                        lambda *tensors: torch.cat(tensors, 1), mbs[0], *mbs[1:]
-                    )
-
-                mb["advantages"] = advantages[: self.step, adv_inds]
-                mb["recurrent_hidden_states"] = mb["recurrent_hidden_states"][0:1]
-
-                mb = tree_map(
-                    lambda v: torch.flatten(v.contiguous(), 0, 1),
-                    tree_map(lambda v: v.to(device=device), mb),
-                )
+                mb = tree_map(lambda v: torch.flatten(v, 0, 1), mb)
 
             yield mb
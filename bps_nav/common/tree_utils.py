@@ -91,6 +91,17 @@ def tree_map(func: Callable, tree: Dict[str, Any]):
     return _tree_map_internal(func, {}, tree)
 
 
+def tree_flatten(tree: Dict[str, Any]) -> List[Any]:
+    leaves = []
+    for v in tree.values():
+        if isinstance(v, dict):
+            leaves.extend(tree_flatten(v))
+        else:
+            leaves.append(v)
+
+    return leaves
+
+
 def tree_select(inds, tree: Dict[str, Any]):
     return tree_map(lambda v: v[inds], tree)
 
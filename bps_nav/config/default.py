@@ -47,6 +47,9 @@ _C.RESOLUTION = [128, 128]
 _C.COLOR = False
 _C.DEPTH = True
 _C.NUM_PARALLEL_SCENES = 4
+# Have the simulator write rewards, masks, infos and pointgoals straight into
+# pinned rollout buffers instead of copying them in after every step
+_C.SIM_ROLLOUT_BUFFERS = False
 _C.TASK = "PointNav"
 # -----------------------------------------------------------------------------
 # EVAL CONFIG
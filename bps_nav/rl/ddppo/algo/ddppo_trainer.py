@@ -216,6 +216,10 @@ class DDPPOTrainer(PPOTrainer):
         actions = [None for _ in range(len(rollouts))]
         is_double_buffered = len(rollouts) > 1
 
+        for idx in range(len(rollouts)):
+            if rollouts[idx].host_buffers is not None:
+                self.envs.set_rollout_step(idx, rollouts[idx].step)
+
         for idx in range(len(rollouts)):
             actions[idx] = self._inference(rollouts, idx)
 
@@ -248,6 +252,10 @@ class DDPPOTrainer(PPOTrainer):
                 else:
                     sim_step_reses[idx] = self._step_simulation(actions[idx], idx)
 
+                sim_step_reses[idx] = self._host_step_results(
+                    rollouts, sim_step_reses[idx], idx
+                )
+
                 self._update_stats(
                     rollouts,
                     current_episode_reward,
@@ -267,6 +275,10 @@ class DDPPOTrainer(PPOTrainer):
             if is_last_step:
                 break
 
+        for idx in range(len(rollouts)):
+            if rollouts[idx].host_buffers is not None:
+                rollouts[idx].copy_host_rewards()
+
         return count_steps_delta
 
     def _warmup(self, rollouts):
@@ -541,6 +553,7 @@ class DDPPOTrainer(PPOTrainer):
             self.config,
             num_worker_groups=self.config.NUM_PARALLEL_SCENES,
             double_buffered=double_buffered,
+            rollouts=rollouts if self.config.SIM_ROLLOUT_BUFFERS else None,
         )
 
         def _setup_render_and_populate_initial_frame():
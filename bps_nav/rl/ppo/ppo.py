@@ -36,40 +36,20 @@ EPS_PPO = 1e-5
 
 @torch.no_grad()
 def vtrace(rewards_batch, value_preds, masks_batch, ratios, gamma, tau, rho, c):
-    T, N, _ = rewards_batch.size()
-    value_preds = value_preds.view(T + 1, N, 1)
-    masks_batch = masks_batch.view(T + 1, N, 1)
-    ratios = ratios.view(T + 1, N, 1)
-
-    vs = value_preds.clone()
+    import bps_pytorch
 
-    gamma_masks = gamma * masks_batch[1:]
+    T, N, _ = rewards_batch.size()
 
-    clipped_rho = torch.min(
-        ratios[0:T], torch.tensor(rho, device=ratios.device, dtype=ratios.dtype)
+    return bps_pytorch.compute_vtrace(
+        rewards_batch,
+        value_preds.view(T + 1, N, 1),
+        masks_batch.view(T + 1, N, 1),
+        ratios.view(T + 1, N, 1),
+        gamma,
+        tau,
+        rho,
+        c,
     )
-    deltas = clipped_rho * (
-        rewards_batch + gamma_masks * value_preds[1:] - value_preds[0:T]
-    )
-
-    c_masks = (
-        tau
-        * gamma_masks
-        * torch.min(
-            ratios[0:T], torch.tensor(c, device=ratios.device, dtype=ratios.dtype)
-        )
-    )
-
-    for step in reversed(range(T)):
-        vs[step] = (
-            value_preds[step]
-            + deltas[step]
-            + c_masks[step] * (vs[step + 1] - value_preds[step + 1])
-        )
-
-    advantages = clipped_rho * (rewards_batch + gamma_masks * vs[1:] - value_preds[0:T])
-
-    return advantages, vs[0:T]
 
 
 def compute_ppo_loss(ratio, adv_targ, valids_batch=None, clip_param=None):
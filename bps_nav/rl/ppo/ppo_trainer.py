@@ -6,7 +6,7 @@
 
 import os
 import time
-from collections import defaultdict, deque
+from collections import OrderedDict, defaultdict, deque
 from typing import Any, Dict, List, Optional
 import time
 
@@ -261,6 +261,18 @@ class PPOTrainer(BaseRLTrainer):
 
             return obs, rewards, masks, infos
 
+    def _host_step_results(self, rollouts, sim_step_res, idx):
+        if rollouts[idx].host_buffers is None:
+            return sim_step_res
+
+        batch = sim_step_res[0]
+        rewards, masks, infos, polars = rollouts[idx].host_step_results()
+        if "pointgoal_with_gps_compass" in batch:
+            batch = OrderedDict(batch)
+            batch["pointgoal_with_gps_compass"] = polars
+
+        return batch, rewards, masks, infos
+
     def _render(self, idx):
         with self.timing.add_time("Rollout-Step"), self.timing.add_time(
             "Renderer-Start"
@@ -275,9 +287,13 @@ class PPOTrainer(BaseRLTrainer):
                 torch.cuda.current_stream().synchronize()
 
             with self.timing.add_time("Rollouts-Insert"):
-                rollouts[idx].insert(
-                    batch, rewards=rewards, masks=masks, non_blocking=False
-                )
+                if rollouts[idx].host_buffers is None:
+                    rollouts[idx].insert(
+                        batch, rewards=rewards, masks=masks, non_blocking=False
+                    )
+                else:
+                    # Rewards are copied over once the rollout is done
+                    rollouts[idx].insert(batch, masks=masks, non_blocking=True)
 
             rollouts[idx].advance()
 
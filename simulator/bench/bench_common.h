@@ -0,0 +1,167 @@
+// Navmesh and episode loading shared by the navigation benchmarks
+
+#pragma once
+
+#include <DetourAlloc.h>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <simdjson.h>
+#include <zlib.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace NavBench {
+
+// Matches PathFinder's on disk navmesh format
+constexpr int NAVMESHSET_MAGIC = 'M' << 24 | 'S' << 16 | 'E' << 8 | 'T';
+constexpr int NAVMESHSET_VERSION = 1;
+
+struct NavMeshSetHeader {
+    int magic;
+    int version;
+    int numTiles;
+    dtNavMeshParams params;
+};
+
+struct NavMeshTileHeader {
+    dtTileRef tileRef;
+    int dataSize;
+};
+
+constexpr unsigned short POLYFLAGS_WALK = 0x01;
+constexpr int MAX_QUERY_NODES = 2048;
+constexpr int MAX_POLYS = 256;
+constexpr float POLY_PICK_EXTENTS[3] = {2, 4, 2};
+
+struct NavMeshDeleter {
+    void operator()(dtNavMesh *mesh) { dtFreeNavMesh(mesh); }
+};
+
+struct NavQueryDeleter {
+    void operator()(dtNavMeshQuery *query) { dtFreeNavMeshQuery(query); }
+};
+
+struct Query {
+    std::array<float, 3> start;
+    std::array<float, 3> goal;
+    dtPolyRef startRef;
+    dtPolyRef goalRef;
+};
+
+inline std::unique_ptr<dtNavMesh, NavMeshDeleter> loadNavMesh(
+    const std::string &path)
+{
+    std::unique_ptr<FILE, decltype(&fclose)> file(fopen(path.c_str(), "rb"),
+                                                  &fclose);
+    if (!file) {
+        return nullptr;
+    }
+
+    NavMeshSetHeader header;
+    if (fread(&header, sizeof(header), 1, file.get()) != 1 ||
+        header.magic != NAVMESHSET_MAGIC ||
+        header.version != NAVMESHSET_VERSION) {
+        return nullptr;
+    }
+
+    std::unique_ptr<dtNavMesh, NavMeshDeleter> mesh(dtAllocNavMesh());
+    if (!mesh || dtStatusFailed(mesh->init(&header.params))) {
+        return nullptr;
+    }
+
+    for (int i = 0; i < header.numTiles; i++) {
+        NavMeshTileHeader tile_header;
+        if (fread(&tile_header, sizeof(tile_header), 1, file.get()) != 1) {
+            return nullptr;
+        }
+
+        if (!tile_header.tileRef || !tile_header.dataSize) {
+            break;
+        }
+
+        auto data = static_cast<unsigned char *>(
+            dtAlloc(tile_header.dataSize, DT_ALLOC_PERM));
+        if (fread(data, tile_header.dataSize, 1, file.get()) != 1) {
+            dtFree(data);
+            return nullptr;
+        }
+
+        mesh->addTile(data, tile_header.dataSize, DT_TILE_FREE_DATA,
+                      tile_header.tileRef, nullptr);
+    }
+
+    return mesh;
+}
+
+// The start / goal pairs of a PointNav episode file. The poly refs are left
+// for the benchmark to snap with its own filter.
+inline std::vector<Query> loadQueries(const std::string &path)
+{
+    gzFile gz = gzopen(path.c_str(), "rb");
+    if (gz == nullptr) {
+        std::cerr << "Failed to open " << path << std::endl;
+        abort();
+    }
+
+    std::string json;
+    std::array<char, 1 << 16> buffer;
+    int num_read;
+    while ((num_read = gzread(gz, buffer.data(), buffer.size())) > 0) {
+        json.append(buffer.data(), num_read);
+    }
+    gzclose(gz);
+
+    if (num_read < 0) {
+        std::cerr << "Failed to read " << path << std::endl;
+        abort();
+    }
+
+    simdjson::dom::parser parser;
+    simdjson::dom::element root = parser.parse(json);
+
+    auto fill_vec = [](auto &vec, const auto &json_arr) {
+        uint32_t idx = 0;
+        for (double component : json_arr) {
+            vec[idx] = component;
+            idx++;
+        }
+    };
+
+    std::vector<Query> queries;
+    for (const auto &json_episode : root["episodes"]) {
+        Query query {};
+        fill_vec(query.start, json_episode["start_position"]);
+        fill_vec(query.goal, json_episode["goals"].at(0)["position"]);
+        queries.push_back(query);
+    }
+
+    return queries;
+}
+
+// Mean time per query of fn, which runs all num_queries queries once and
+// returns a checksum of the results
+template <typename Fn>
+double timeNs(uint32_t iterations, size_t num_queries, Fn &&fn)
+{
+    // Keeps the results live so the work can't be optimized out
+    volatile uint64_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t iter = 0; iter < iterations; iter++) {
+        sink = sink + fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() /
+           (double(iterations) * num_queries);
+}
+
+}
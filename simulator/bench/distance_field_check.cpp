@@ -0,0 +1,148 @@
+// Checks PathFinder's distance fields against exact geodesic distances.
+//
+// A perfect maze with one cell wide corridors has a single chain of polys
+// between any two points, so the string pulled length of findPath's path is
+// the exact geodesic distance. Fields are built from random sources in a
+// generated maze, tiled so portals also cross tile edges, and every lookup
+// from random points has to match findPath.
+//
+// Usage: distance_field_check OUT_DIR [KEY=VALUE...]
+// Keys: size, sources, points, seed, tile_cells
+
+#include "synthetic_scene.h"
+
+#include <PathFinder.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+using namespace NavBench;
+
+namespace {
+
+// Both sides sum float segment lengths, in different orders
+constexpr float ABS_TOLERANCE = 1e-3;
+constexpr float REL_TOLERANCE = 1e-4;
+
+void usage(const char *name)
+{
+    cerr << name << " OUT_DIR [KEY=VALUE...]\n"
+         << "Keys: size, sources, points, seed, tile_cells" << endl;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    unordered_map<string, double> options {
+        {"size", 20},
+        {"sources", 150},
+        {"points", 100},
+        {"seed", 0},
+        {"tile_cells", 16},
+    };
+
+    for (int i = 2; i < argc; i++) {
+        const string arg = argv[i];
+        size_t eq = arg.find('=');
+        auto iter = options.find(arg.substr(0, eq));
+        if (eq == string::npos || iter == options.end()) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        iter->second = stod(arg.substr(eq + 1));
+    }
+
+    const uint32_t seed = options["seed"];
+
+    MazeParams params;
+    params.size = options["size"];
+    params.corridorCells = 1;
+    params.loopFraction = 0;
+    SyntheticScene scene = makeMazeScene(params, seed);
+
+    auto mesh = buildSyntheticNavMesh(scene, options["tile_cells"]);
+    const string navmesh_path = string(argv[1]) + "/perfect_maze.navmesh";
+    if (!mesh || !writeNavMesh(*mesh, navmesh_path)) {
+        cerr << "Failed to write " << navmesh_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    esp::nav::PathFinder pathfinder;
+    if (!pathfinder.loadNavMesh(navmesh_path)) {
+        cerr << "Failed to load " << navmesh_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    mt19937 rgen(seed);
+    uniform_int_distribution<size_t> cell_dist(0, scene.cells.size() - 1);
+    uniform_real_distribution<float> offset_dist(0.02f, 0.98f);
+    auto random_point = [&]() {
+        const SyntheticCell &cell = scene.cells[cell_dist(rgen)];
+        return pathfinder.snapPoint(
+            esp::vec3f((cell.x + offset_dist(rgen)) * scene.cellSize,
+                       cell.y[0] * scene.cellHeight,
+                       (cell.z + offset_dist(rgen)) * scene.cellSize));
+    };
+
+    esp::nav::DistanceField field;
+    uint64_t num_checked = 0, num_skipped = 0, num_mismatched = 0;
+    double total_error = 0, max_error = 0;
+
+    for (uint32_t i = 0; i < options["sources"]; i++) {
+        const esp::nav::NavMeshPoint source = random_point();
+        if (!pathfinder.buildDistanceField(source, field)) {
+            cerr << "Failed to build a field" << endl;
+            return EXIT_FAILURE;
+        }
+
+        for (uint32_t j = 0; j < options["points"]; j++) {
+            esp::nav::ShortestPath path;
+            path.requestedStart = random_point();
+            path.requestedEnd = source;
+
+            // Paths past findPath's search limits
+            if (!pathfinder.findPath(path) ||
+                !isfinite(path.geodesicDistance)) {
+                num_skipped++;
+                continue;
+            }
+
+            const float distance =
+                pathfinder.geodesicDistance(field, path.requestedStart);
+            const float error = fabsf(distance - path.geodesicDistance);
+            if (error > ABS_TOLERANCE + REL_TOLERANCE * path.geodesicDistance) {
+                if (num_mismatched++ < 10) {
+                    const esp::vec3f &pt = path.requestedStart.xyz;
+                    printf("(%.3f, %.3f, %.3f) to (%.3f, %.3f, %.3f): field "
+                           "%.4f, geodesic %.4f\n",
+                           pt[0], pt[1], pt[2], source.xyz[0], source.xyz[1],
+                           source.xyz[2], distance, path.geodesicDistance);
+                }
+            }
+
+            num_checked++;
+            total_error += error;
+            max_error = max(max_error, double(error));
+        }
+    }
+
+    printf("%lu pairs, %lu skipped, %lu mismatched, mean error %.2e m, max "
+           "error %.2e m\n",
+           num_checked, num_skipped, num_mismatched,
+           num_checked ? total_error / num_checked : 0., max_error);
+
+    return num_mismatched == 0 && num_checked > 0 ? EXIT_SUCCESS
+                                                 : EXIT_FAILURE;
+}
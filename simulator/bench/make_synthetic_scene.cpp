@@ -0,0 +1,174 @@
+// Generates a synthetic navmesh and a matching PointNav episode file, for
+// running the navigation benchmarks without any downloaded scenes.
+//
+// Writes OUT_DIR/NAME.navmesh and OUT_DIR/NAME.json.gz, whose episodes use
+// the scene id NAME.glb. There's no render asset, so the episodes are for
+// navigation only benchmarks such as pathfinder_bench.
+//
+// Layouts:
+//   maze     a grid maze, size junctions along each side
+//   rooms    a floor of size x size rooms joined by doors
+//   storeys  storeys floors of rooms, joined by ramps
+//
+// Usage: make_synthetic_scene LAYOUT OUT_DIR NAME [KEY=VALUE...]
+// Keys: size, storeys, episodes, seed, tile_cells, min_distance,
+//       max_distance
+
+#include "synthetic_scene.h"
+
+#include <PathFinder.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+using namespace NavBench;
+
+namespace {
+
+void usage(const char *name)
+{
+    cerr << name << " maze|rooms|storeys OUT_DIR NAME [KEY=VALUE...]\n"
+         << "Keys: size, storeys, episodes, seed, tile_cells, min_distance, "
+            "max_distance"
+         << endl;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const string layout = argv[1];
+    const string out_prefix = string(argv[2]) + "/" + argv[3];
+
+    unordered_map<string, double> options {
+        {"size", -1},
+        {"storeys", StoreysParams().storeys},
+        {"episodes", EpisodeParams().numEpisodes},
+        {"seed", 0},
+        {"tile_cells", 64},
+        {"min_distance", EpisodeParams().minDistance},
+        {"max_distance", EpisodeParams().maxDistance},
+    };
+
+    for (int i = 4; i < argc; i++) {
+        const string arg = argv[i];
+        size_t eq = arg.find('=');
+        auto iter = options.find(arg.substr(0, eq));
+        if (eq == string::npos || iter == options.end()) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        iter->second = stod(arg.substr(eq + 1));
+    }
+
+    const int32_t size = options["size"];
+    const uint32_t seed = options["seed"];
+
+    SyntheticScene scene;
+    if (layout == "maze") {
+        MazeParams params;
+        params.size = size > 0 ? size : params.size;
+        scene = makeMazeScene(params, seed);
+    } else if (layout == "rooms") {
+        RoomsParams params;
+        params.size = size > 0 ? size : params.size;
+        scene = makeRoomsScene(params, seed);
+    } else if (layout == "storeys") {
+        StoreysParams params;
+        params.rooms.size = size > 0 ? size : params.rooms.size;
+        params.storeys = options["storeys"];
+        scene = makeStoreysScene(params, seed);
+    } else {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (scene.cells.empty()) {
+        cerr << "Layout " << layout << " has no cells with these options"
+             << endl;
+        return EXIT_FAILURE;
+    }
+
+    auto mesh = buildSyntheticNavMesh(scene, options["tile_cells"]);
+    if (!mesh) {
+        cerr << "Failed to build the navmesh, try a smaller tile_cells"
+             << endl;
+        return EXIT_FAILURE;
+    }
+
+    const string navmesh_path = out_prefix + ".navmesh";
+    if (!writeNavMesh(*mesh, navmesh_path)) {
+        cerr << "Failed to write " << navmesh_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    EpisodeParams episode_params;
+    episode_params.numEpisodes = options["episodes"];
+    episode_params.minDistance = options["min_distance"];
+    episode_params.maxDistance = options["max_distance"];
+
+    // Distances from PathFinder, as the simulator will measure them, which
+    // also drops pairs beyond its search limits
+    esp::nav::PathFinder pathfinder;
+    if (!pathfinder.loadNavMesh(navmesh_path)) {
+        cerr << "Failed to load " << navmesh_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    auto geodesic = [&](const array<float, 3> &start,
+                        const array<float, 3> &goal) {
+        esp::nav::ShortestPath path;
+        path.requestedStart = pathfinder.snapPoint(
+            esp::vec3f(start[0], start[1], start[2]));
+        path.requestedEnd =
+            pathfinder.snapPoint(esp::vec3f(goal[0], goal[1], goal[2]));
+        return pathfinder.findPath(path) ? path.geodesicDistance : -1.f;
+    };
+
+    vector<SyntheticEpisode> episodes =
+        makeSyntheticEpisodes(scene, episode_params, seed, geodesic);
+
+    const string episodes_path = out_prefix + ".json.gz";
+    if (!writeEpisodes(episodes, string(argv[3]) + ".glb", episodes_path)) {
+        cerr << "Failed to write " << episodes_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    const dtNavMesh &const_mesh = *mesh;
+    int num_tiles = 0, num_polys = 0;
+    for (int i = 0; i < const_mesh.getMaxTiles(); i++) {
+        const dtMeshTile *tile = const_mesh.getTile(i);
+        if (tile && tile->header) {
+            num_tiles++;
+            num_polys += tile->header->polyCount;
+        }
+    }
+
+    double total_distance = 0;
+    for (const SyntheticEpisode &episode : episodes) {
+        total_distance += episode.geodesicDistance;
+    }
+
+    printf("%s: %d polys in %d tiles, %zu episodes, mean geodesic distance "
+           "%.2f m\n",
+           navmesh_path.c_str(), num_polys, num_tiles, episodes.size(),
+           episodes.empty() ? 0. : total_distance / episodes.size());
+
+    if (episodes.size() < episode_params.numEpisodes) {
+        cerr << "Only found " << episodes.size() << " of "
+             << episode_params.numEpisodes
+             << " episodes within the distance limits" << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
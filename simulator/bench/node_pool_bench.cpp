@@ -0,0 +1,224 @@
+// Measures the node pool's share of dtNavMeshQuery's per query cost,
+// comparing dtNodePool, which wipes its whole hash table on every clear(),
+// against dtStampedNodePool, which only bumps a stamp.
+//
+// Runs findPath between the start / goal pairs of a PointNav episode file and
+// findDistanceToWall around each start, and records the nodes each query
+// allocated. The recordings are then replayed against both pools: a clear(),
+// a getNode() per node in allocation order, and a findNode() per node, as a
+// search's later visits would do. The full queries are also timed with the
+// pool this build's dtNavMeshQuery uses.
+//
+// Usage: node_pool_bench SCENE.navmesh EPISODES.json.gz [ITERATIONS]
+
+#include "bench_common.h"
+
+#include <DetourCommon.h>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <DetourNode.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace NavBench;
+
+namespace {
+
+constexpr float WALL_SEARCH_RADIUS = 2.f;
+
+#ifdef DT_STAMPED_NODEPOOL
+constexpr const char *QUERY_NODE_POOL = "dtStampedNodePool";
+#else
+constexpr const char *QUERY_NODE_POOL = "dtNodePool";
+#endif
+
+// The nodes each recorded query allocated, in allocation order
+struct NodeTrace {
+    vector<dtPolyRef> ids;
+    vector<unsigned char> states;
+    vector<uint32_t> offsets {0};
+
+    size_t numQueries() const { return offsets.size() - 1; }
+
+    void record(const dtQueryNodePool &pool)
+    {
+        for (int i = 0; i < pool.getNodeCount(); i++) {
+            const dtNode *node = pool.getNodeAtIdx(i + 1);
+            ids.push_back(node->id);
+            states.push_back(node->state);
+        }
+        offsets.push_back(ids.size());
+    }
+};
+
+template <typename Pool>
+uint64_t replay(Pool &pool, const NodeTrace &trace)
+{
+    uint64_t checksum = 0;
+    for (size_t query = 0; query < trace.numQueries(); query++) {
+        const uint32_t begin = trace.offsets[query];
+        const uint32_t end = trace.offsets[query + 1];
+
+        pool.clear();
+        for (uint32_t i = begin; i < end; i++) {
+            dtNode *node = pool.getNode(trace.ids[i], trace.states[i]);
+            checksum = checksum * 31 + pool.getNodeIdx(node);
+        }
+
+        for (uint32_t i = begin; i < end; i++) {
+            dtNode *node = pool.findNode(trace.ids[i], trace.states[i]);
+            checksum = checksum * 31 + pool.getNodeIdx(node);
+        }
+    }
+
+    return checksum;
+}
+
+template <typename Pool>
+uint64_t clearOnly(Pool &pool, const NodeTrace &trace)
+{
+    uint64_t checksum = 0;
+    for (size_t query = 0; query < trace.numQueries(); query++) {
+        pool.clear();
+        checksum += pool.getNodeCount();
+    }
+
+    return checksum;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        cerr << argv[0] << " SCENE.navmesh EPISODES.json.gz [ITERATIONS]"
+             << endl;
+        return EXIT_FAILURE;
+    }
+
+    auto mesh = loadNavMesh(argv[1]);
+    if (!mesh) {
+        cerr << "Failed to load " << argv[1] << endl;
+        return EXIT_FAILURE;
+    }
+
+    vector<Query> queries = loadQueries(argv[2]);
+    if (queries.empty()) {
+        cerr << "No episodes in " << argv[2] << endl;
+        return EXIT_FAILURE;
+    }
+
+    uint32_t iterations = argc > 3 ? stoul(argv[3]) : 20;
+
+    unique_ptr<dtNavMeshQuery, NavQueryDeleter> query(dtAllocNavMeshQuery());
+    query->init(mesh.get(), MAX_QUERY_NODES);
+
+    dtIncludeFlagsFilter<POLYFLAGS_WALK> walk_filter;
+    dtQueryFilter wall_filter;
+    wall_filter.setIncludeFlags(POLYFLAGS_WALK);
+    wall_filter.setExcludeFlags(0);
+
+    for (Query &q : queries) {
+        float pt[3];
+        query->findNearestPoly(q.start.data(), POLY_PICK_EXTENTS,
+                               &walk_filter, &q.startRef, pt);
+        query->findNearestPoly(q.goal.data(), POLY_PICK_EXTENTS, &walk_filter,
+                               &q.goalRef, pt);
+    }
+
+    auto find_paths = [&]() {
+        uint64_t checksum = 0;
+        dtPolyRef polys[MAX_POLYS];
+        for (const Query &q : queries) {
+            int num_polys = 0;
+            query->findPath(q.startRef, q.goalRef, q.start.data(),
+                            q.goal.data(), &walk_filter, polys, &num_polys,
+                            MAX_POLYS);
+            checksum = checksum * 31 + num_polys;
+        }
+
+        return checksum;
+    };
+
+    auto find_walls = [&]() {
+        uint64_t checksum = 0;
+        for (const Query &q : queries) {
+            float dist = 0.f, pos[3], normal[3];
+            query->findDistanceToWall(q.startRef, q.start.data(),
+                                      WALL_SEARCH_RADIUS, &wall_filter, &dist,
+                                      pos, normal);
+            checksum = checksum * 31 + uint64_t(dist * 1000.f);
+        }
+
+        return checksum;
+    };
+
+    NodeTrace path_trace, wall_trace;
+    dtPolyRef polys[MAX_POLYS];
+    for (const Query &q : queries) {
+        int num_polys = 0;
+        query->findPath(q.startRef, q.goalRef, q.start.data(), q.goal.data(),
+                        &walk_filter, polys, &num_polys, MAX_POLYS);
+        path_trace.record(*query->getNodePool());
+
+        float dist = 0.f, pos[3], normal[3];
+        query->findDistanceToWall(q.startRef, q.start.data(),
+                                  WALL_SEARCH_RADIUS, &wall_filter, &dist, pos,
+                                  normal);
+        wall_trace.record(*query->getNodePool());
+    }
+
+    // Sized the same way dtNavMeshQuery::init sizes its pool
+    const int hash_size = dtNextPow2(MAX_QUERY_NODES / 4);
+    dtNodePool chained_pool(MAX_QUERY_NODES, hash_size);
+    dtStampedNodePool stamped_pool(MAX_QUERY_NODES, hash_size);
+
+    bool mismatch = false;
+    auto compare = [&](const char *name, const NodeTrace &trace,
+                       auto &&run) {
+        auto run_chained = [&]() { return run(chained_pool, trace); };
+        auto run_stamped = [&]() { return run(stamped_pool, trace); };
+
+        if (run_chained() != run_stamped()) {
+            cerr << name << ": results differ between pools" << endl;
+            mismatch = true;
+        }
+
+        const size_t num_queries = trace.numQueries();
+        double chained_ns = timeNs(iterations, num_queries, run_chained);
+        double stamped_ns = timeNs(iterations, num_queries, run_stamped);
+
+        printf("%-26s dtNodePool %8.1f ns  stamped %8.1f ns  speedup %.2fx\n",
+               name, chained_ns, stamped_ns, chained_ns / stamped_ns);
+    };
+
+    auto replay_fn = [](auto &pool, const NodeTrace &trace) {
+        return replay(pool, trace);
+    };
+    auto clear_fn = [](auto &pool, const NodeTrace &trace) {
+        return clearOnly(pool, trace);
+    };
+
+    printf("%zu queries, %u iterations\n", queries.size(), iterations);
+    printf("Mean nodes per query: findPath %.1f, findDistanceToWall %.1f\n",
+           double(path_trace.ids.size()) / path_trace.numQueries(),
+           double(wall_trace.ids.size()) / wall_trace.numQueries());
+
+    compare("clear", path_trace, clear_fn);
+    compare("findPath replay", path_trace, replay_fn);
+    compare("findDistanceToWall replay", wall_trace, replay_fn);
+
+    printf("With %s:\n", QUERY_NODE_POOL);
+    printf("%-26s %8.1f ns\n", "findPath",
+           timeNs(iterations, queries.size(), find_paths));
+    printf("%-26s %8.1f ns\n", "findDistanceToWall",
+           timeNs(iterations, queries.size(), find_walls));
+
+    return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
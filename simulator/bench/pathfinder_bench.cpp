@@ -0,0 +1,506 @@
+// Measures PathFinder's per query latency on recorded query streams, so
+// navmesh changes can be compared on identical workloads.
+//
+// Traces hold each episode's snapped start / goal NavMeshPoints, start
+// heading and actions in a compact binary format. They are normally recorded
+// from training runs: the simulator built with BPS_SIM_RECORD_TRACE records
+// the episodes the policy plays, and its export_query_traces writes one trace
+// per scene.
+//
+// synthesize is the fallback for when there is no recorded trace. It drives
+// its own PointNav agent through each episode of an episode file, taking
+// steps the way the simulator does: the agent follows findPath's path to the
+// goal, with some random actions mixed in.
+//
+// replay runs a trace's query stream again, single threaded and then with
+// the given number of threads, each thread with its own PathFinder sharing
+// the navmesh. Every snapPoint, isNavigable, findPath, tryStep and
+// geodesicDistance call is timed, and latency percentiles are reported per
+// operation.
+//
+// Usage: pathfinder_bench synthesize SCENE.navmesh EPISODES.json.gz TRACE
+//                                    [SEED]
+//        pathfinder_bench replay SCENE.navmesh TRACE [THREADS] [ITERATIONS]
+
+#include "bench_common.h"
+
+#include <PathFinder.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace NavBench;
+
+namespace {
+
+// Matches SimulatorConfig and the PointNav task
+constexpr float FORWARD_STEP_SIZE = 0.25;
+constexpr float TURN_ANGLE = 10.f * M_PI / 180.f;
+constexpr float SUCCESS_DISTANCE = 0.2;
+constexpr uint32_t MAX_STEPS = 500;
+
+// Chance the synthetic agent takes a random action instead of following the
+// path, so traces also cover wall sliding and off path queries
+constexpr float RANDOM_ACTION_PROB = 0.1;
+
+// Matches the simulator's SimAction
+enum Action : uint8_t {
+    STOP = 0,
+    MOVE_FORWARD = 1,
+    TURN_LEFT = 2,
+    TURN_RIGHT = 3,
+};
+
+// Also written by the simulator's QueryTraceRecorder
+constexpr uint32_t TRACE_MAGIC = 'P' << 24 | 'F' << 16 | 'T' << 8 | 'R';
+constexpr uint32_t TRACE_VERSION = 1;
+
+struct TraceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numEpisodes;
+    uint32_t reserved;
+};
+
+// Followed in the trace by numActions one byte Actions
+struct TraceEpisode {
+    uint64_t startPoly;
+    uint64_t goalPoly;
+    float requestedStart[3];
+    float requestedGoal[3];
+    float start[3];
+    float goal[3];
+    // Where the agent ended up, to check replays took the same steps
+    float end[3];
+    float startYaw;
+    uint32_t numActions;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TraceEpisode) == 88);
+
+struct Episode {
+    TraceEpisode header;
+    vector<uint8_t> actions;
+};
+
+esp::vec3f toVec(const float (&v)[3])
+{
+    return esp::vec3f(v[0], v[1], v[2]);
+}
+
+void fromVec(float (&out)[3], const esp::vec3f &v)
+{
+    out[0] = v[0];
+    out[1] = v[1];
+    out[2] = v[2];
+}
+
+// Where MoveForward aims from pos facing yaw, as the simulator rotates its
+// forward vector (0, 0, -FORWARD_STEP_SIZE) about the up axis
+esp::vec3f forwardTarget(const esp::vec3f &pos, float yaw)
+{
+    return pos + esp::vec3f(-sinf(yaw), 0.f, -cosf(yaw)) * FORWARD_STEP_SIZE;
+}
+
+float turn(float yaw, uint8_t action)
+{
+    return action == TURN_LEFT ? yaw + TURN_ANGLE : yaw - TURN_ANGLE;
+}
+
+float wrapAngle(float angle)
+{
+    return remainderf(angle, 2.f * float(M_PI));
+}
+
+bool writeTrace(const string &path, const vector<Episode> &episodes)
+{
+    ofstream out(path, ios::binary);
+    TraceHeader header {TRACE_MAGIC, TRACE_VERSION,
+                        uint32_t(episodes.size()), 0};
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const Episode &episode : episodes) {
+        out.write(reinterpret_cast<const char *>(&episode.header),
+                  sizeof(episode.header));
+        out.write(reinterpret_cast<const char *>(episode.actions.data()),
+                  episode.actions.size());
+    }
+
+    return bool(out);
+}
+
+bool readTrace(const string &path, vector<Episode> &episodes)
+{
+    ifstream in(path, ios::binary);
+    TraceHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        header.magic != TRACE_MAGIC || header.version != TRACE_VERSION) {
+        return false;
+    }
+
+    episodes.resize(header.numEpisodes);
+    for (Episode &episode : episodes) {
+        if (!in.read(reinterpret_cast<char *>(&episode.header),
+                     sizeof(episode.header))) {
+            return false;
+        }
+
+        episode.actions.resize(episode.header.numActions);
+        if (!in.read(reinterpret_cast<char *>(episode.actions.data()),
+                     episode.actions.size())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int synthesize(const string &navmesh_path,
+           const string &episodes_path,
+           const string &trace_path,
+           uint32_t seed)
+{
+    esp::nav::PathFinder pathfinder;
+    if (!pathfinder.loadNavMesh(navmesh_path)) {
+        cerr << "Failed to load " << navmesh_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    vector<Query> queries = loadQueries(episodes_path);
+    if (queries.empty()) {
+        cerr << "No episodes in " << episodes_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    mt19937 rgen(seed);
+    uniform_real_distribution<float> unit_dist(0.f, 1.f);
+    uniform_int_distribution<int> action_dist(MOVE_FORWARD, TURN_RIGHT);
+
+    vector<Episode> episodes;
+    episodes.reserve(queries.size());
+    uint64_t num_steps = 0;
+    uint32_t num_successes = 0;
+
+    for (const Query &q : queries) {
+        Episode episode {};
+        TraceEpisode &header = episode.header;
+        copy(q.start.begin(), q.start.end(), header.requestedStart);
+        copy(q.goal.begin(), q.goal.end(), header.requestedGoal);
+        header.startYaw = wrapAngle(unit_dist(rgen) * 2.f * float(M_PI));
+
+        esp::nav::NavMeshPoint pos =
+            pathfinder.snapPoint(toVec(header.requestedStart));
+        esp::nav::NavMeshPoint goal =
+            pathfinder.snapPoint(toVec(header.requestedGoal));
+        header.startPoly = pos.polyId;
+        header.goalPoly = goal.polyId;
+        fromVec(header.start, pos.xyz);
+        fromVec(header.goal, goal.xyz);
+
+        float yaw = header.startYaw;
+        esp::nav::ShortestPath path;
+        path.requestedEnd = goal;
+
+        for (uint32_t step = 0; step < MAX_STEPS; step++) {
+            path.requestedStart = pos;
+            bool found = pathfinder.findPath(path);
+
+            uint8_t action;
+            if (!found || path.geodesicDistance < SUCCESS_DISTANCE ||
+                path.points.size() < 2) {
+                action = STOP;
+            } else if (unit_dist(rgen) < RANDOM_ACTION_PROB) {
+                action = action_dist(rgen);
+            } else {
+                esp::vec3f to_waypoint = path.points[1] - pos.xyz;
+                float target_yaw = atan2f(-to_waypoint[0], -to_waypoint[2]);
+                float diff = wrapAngle(target_yaw - yaw);
+                if (fabsf(diff) <= TURN_ANGLE / 2) {
+                    action = MOVE_FORWARD;
+                } else {
+                    action = diff > 0 ? TURN_LEFT : TURN_RIGHT;
+                }
+            }
+
+            episode.actions.push_back(action);
+            if (action == STOP) {
+                num_successes += found &&
+                                 path.geodesicDistance < SUCCESS_DISTANCE;
+                break;
+            }
+
+            if (action == MOVE_FORWARD) {
+                pos = pathfinder.tryStep(pos, forwardTarget(pos.xyz, yaw));
+            } else {
+                yaw = turn(yaw, action);
+            }
+
+            pathfinder.geodesicDistance(pos, goal);
+        }
+
+        fromVec(header.end, pos.xyz);
+        header.numActions = episode.actions.size();
+        num_steps += episode.actions.size();
+        episodes.push_back(move(episode));
+    }
+
+    if (!writeTrace(trace_path, episodes)) {
+        cerr << "Failed to write " << trace_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    printf("Synthesized %zu episodes, %lu steps, %u reached the goal\n",
+           episodes.size(), num_steps, num_successes);
+
+    return EXIT_SUCCESS;
+}
+
+enum Op : uint32_t {
+    OP_SNAP_POINT,
+    OP_IS_NAVIGABLE,
+    OP_FIND_PATH,
+    OP_TRY_STEP,
+    OP_GEODESIC_DISTANCE,
+    NUM_OPS,
+};
+
+constexpr array<const char *, NUM_OPS> OP_NAMES {
+    "snapPoint", "isNavigable", "findPath", "tryStep", "geodesicDistance",
+};
+
+struct ReplayResult {
+    array<vector<uint32_t>, NUM_OPS> latencies;
+    uint32_t numDiverged = 0;
+    double wallNs = 0;
+};
+
+// Replays one episode's query stream at a time, timing each query
+struct Replayer {
+    esp::nav::PathFinder pathfinder;
+    ReplayResult result;
+
+    template <typename Fn>
+    auto timed(Op op, Fn &&fn)
+    {
+        auto start = chrono::steady_clock::now();
+        auto value = fn();
+        auto end = chrono::steady_clock::now();
+        result.latencies[op].push_back(
+            chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+
+        return value;
+    }
+
+    void replay(const Episode &episode)
+    {
+        const TraceEpisode &header = episode.header;
+
+        esp::nav::NavMeshPoint pos = timed(OP_SNAP_POINT, [&]() {
+            return pathfinder.snapPoint(toVec(header.requestedStart));
+        });
+        esp::nav::NavMeshPoint goal = timed(OP_SNAP_POINT, [&]() {
+            return pathfinder.snapPoint(toVec(header.requestedGoal));
+        });
+        timed(OP_IS_NAVIGABLE, [&]() {
+            return pathfinder.isNavigable(toVec(header.requestedStart));
+        });
+        timed(OP_IS_NAVIGABLE, [&]() {
+            return pathfinder.isNavigable(toVec(header.requestedGoal));
+        });
+
+        float yaw = header.startYaw;
+        esp::nav::ShortestPath path;
+        path.requestedEnd = goal;
+
+        for (uint8_t action : episode.actions) {
+            path.requestedStart = pos;
+            timed(OP_FIND_PATH, [&]() { return pathfinder.findPath(path); });
+
+            if (action == STOP) {
+                break;
+            }
+
+            if (action == MOVE_FORWARD) {
+                pos = timed(OP_TRY_STEP, [&]() {
+                    return pathfinder.tryStep(pos,
+                                              forwardTarget(pos.xyz, yaw));
+                });
+            } else {
+                yaw = turn(yaw, action);
+            }
+
+            timed(OP_GEODESIC_DISTANCE, [&]() {
+                return pathfinder.geodesicDistance(pos, goal);
+            });
+        }
+
+        if ((pos.xyz - toVec(header.end)).squaredNorm() > 1e-6f) {
+            result.numDiverged++;
+        }
+    }
+};
+
+ReplayResult replayAll(const esp::nav::PathFinder &shared,
+                       const vector<Episode> &episodes,
+                       uint32_t num_threads,
+                       uint32_t iterations)
+{
+    vector<Replayer> replayers(num_threads);
+    for (Replayer &replayer : replayers) {
+        replayer.pathfinder.shareNavMesh(shared);
+    }
+
+    auto start = chrono::steady_clock::now();
+
+    vector<thread> threads;
+    for (uint32_t thread_idx = 0; thread_idx < num_threads; thread_idx++) {
+        threads.emplace_back([&, thread_idx]() {
+            Replayer &replayer = replayers[thread_idx];
+            for (uint32_t iter = 0; iter < iterations; iter++) {
+                for (size_t i = thread_idx; i < episodes.size();
+                     i += num_threads) {
+                    replayer.replay(episodes[i]);
+                }
+            }
+        });
+    }
+
+    for (thread &t : threads) {
+        t.join();
+    }
+
+    ReplayResult merged;
+    merged.wallNs = chrono::duration<double, nano>(
+                        chrono::steady_clock::now() - start)
+                        .count();
+
+    for (Replayer &replayer : replayers) {
+        for (uint32_t op = 0; op < NUM_OPS; op++) {
+            auto &latencies = replayer.result.latencies[op];
+            merged.latencies[op].insert(merged.latencies[op].end(),
+                                        latencies.begin(), latencies.end());
+        }
+        merged.numDiverged += replayer.result.numDiverged;
+    }
+
+    return merged;
+}
+
+void report(uint32_t num_threads, ReplayResult &result)
+{
+    uint64_t total_ops = 0;
+    for (const auto &latencies : result.latencies) {
+        total_ops += latencies.size();
+    }
+
+    printf("%u thread%s: %.3f M queries/s\n", num_threads,
+           num_threads == 1 ? "" : "s", total_ops / result.wallNs * 1e3);
+    printf("  %-18s %10s %9s %9s %9s %9s %9s\n", "op", "count", "p50 ns",
+           "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+
+    for (uint32_t op = 0; op < NUM_OPS; op++) {
+        vector<uint32_t> &latencies = result.latencies[op];
+        if (latencies.empty()) {
+            continue;
+        }
+
+        sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {
+            size_t idx = size_t(p * (latencies.size() - 1) + 0.5);
+            return latencies[idx];
+        };
+
+        printf("  %-18s %10zu %9u %9u %9u %9u %9u\n", OP_NAMES[op],
+               latencies.size(), percentile(0.5), percentile(0.9),
+               percentile(0.99), percentile(0.999), latencies.back());
+    }
+
+    if (result.numDiverged > 0) {
+        printf("  %u replays ended away from the recorded position, the "
+               "navmesh or PathFinder changed since recording\n",
+               result.numDiverged);
+    }
+}
+
+int replay(const string &navmesh_path,
+           const string &trace_path,
+           uint32_t num_threads,
+           uint32_t iterations)
+{
+    esp::nav::PathFinder pathfinder;
+    if (!pathfinder.loadNavMesh(navmesh_path)) {
+        cerr << "Failed to load " << navmesh_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    vector<Episode> episodes;
+    if (!readTrace(trace_path, episodes)) {
+        cerr << "Failed to read " << trace_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    uint64_t num_steps = 0;
+    for (const Episode &episode : episodes) {
+        num_steps += episode.actions.size();
+    }
+    printf("%zu episodes, %lu steps, %u iterations\n", episodes.size(),
+           num_steps, iterations);
+
+    // Warms up the per thread query storage and the caches
+    replayAll(pathfinder, episodes, 1, 1);
+
+    ReplayResult single = replayAll(pathfinder, episodes, 1, iterations);
+    report(1, single);
+
+    if (num_threads > 1) {
+        ReplayResult multi =
+            replayAll(pathfinder, episodes, num_threads, iterations);
+        report(num_threads, multi);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void usage(const char *name)
+{
+    cerr << name
+         << " synthesize SCENE.navmesh EPISODES.json.gz TRACE [SEED]\n"
+         << name << " replay SCENE.navmesh TRACE [THREADS] [ITERATIONS]"
+         << endl;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const string mode = argv[1];
+    if (mode == "synthesize" && argc >= 5) {
+        uint32_t seed = argc > 5 ? stoul(argv[5]) : 0;
+        return synthesize(argv[2], argv[3], argv[4], seed);
+    } else if (mode == "replay") {
+        uint32_t num_threads =
+            argc > 4 ? stoul(argv[4]) : thread::hardware_concurrency();
+        uint32_t iterations = argc > 5 ? stoul(argv[5]) : 5;
+        return replay(argv[2], argv[3], max(num_threads, 1u), iterations);
+    }
+
+    usage(argv[0]);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,164 @@
+// Compares the virtual dtQueryFilter path of dtNavMeshQuery against the
+// filter-templated path PathFinder uses, on the start / goal pairs of a
+// PointNav episode file.
+//
+// Usage: query_filter_bench SCENE.navmesh EPISODES.json.gz [ITERATIONS]
+
+#include "bench_common.h"
+
+#include <DetourCommon.h>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace NavBench;
+
+namespace {
+
+constexpr float FORWARD_STEP_SIZE = 0.25;
+
+// Runs each benchmarked operation once with the given filter and returns a
+// checksum of the results, so both paths can be checked for agreement.
+template <typename Filter>
+struct FilterRunner {
+    const dtNavMeshQuery &query;
+    const Filter &filter;
+    vector<Query> &queries;
+
+    uint64_t snap() const
+    {
+        uint64_t checksum = 0;
+        for (Query &q : queries) {
+            float pt[3];
+            query.findNearestPoly(q.start.data(), POLY_PICK_EXTENTS, &filter,
+                                  &q.startRef, pt);
+            query.findNearestPoly(q.goal.data(), POLY_PICK_EXTENTS, &filter,
+                                  &q.goalRef, pt);
+            checksum += q.startRef * 31 + q.goalRef;
+        }
+
+        return checksum;
+    }
+
+    uint64_t findPath() const
+    {
+        uint64_t checksum = 0;
+        dtPolyRef polys[MAX_POLYS];
+        for (const Query &q : queries) {
+            int num_polys = 0;
+            query.findPath(q.startRef, q.goalRef, q.start.data(),
+                           q.goal.data(), &filter, polys, &num_polys,
+                           MAX_POLYS);
+            for (int i = 0; i < num_polys; i++) {
+                checksum = checksum * 31 + polys[i];
+            }
+        }
+
+        return checksum;
+    }
+
+    uint64_t moveAlongSurface() const
+    {
+        uint64_t checksum = 0;
+        dtPolyRef polys[MAX_POLYS];
+        for (const Query &q : queries) {
+            float dir[3];
+            dtVsub(dir, q.goal.data(), q.start.data());
+            float len = dtVlen(dir);
+            if (len == 0.f) {
+                continue;
+            }
+
+            float end[3];
+            dtVmad(end, q.start.data(), dir, FORWARD_STEP_SIZE / len);
+
+            float result[3] {};
+            int num_polys = 0;
+            query.moveAlongSurface(q.startRef, q.start.data(), end, &filter,
+                                   result, polys, &num_polys, MAX_POLYS,
+                                   false);
+            checksum = checksum * 31 + num_polys;
+            uint32_t bits;
+            memcpy(&bits, &result[0], sizeof(bits));
+            checksum = checksum * 31 + bits;
+        }
+
+        return checksum;
+    }
+};
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        cerr << argv[0] << " SCENE.navmesh EPISODES.json.gz [ITERATIONS]"
+             << endl;
+        return EXIT_FAILURE;
+    }
+
+    auto mesh = loadNavMesh(argv[1]);
+    if (!mesh) {
+        cerr << "Failed to load " << argv[1] << endl;
+        return EXIT_FAILURE;
+    }
+
+    vector<Query> queries = loadQueries(argv[2]);
+    if (queries.empty()) {
+        cerr << "No episodes in " << argv[2] << endl;
+        return EXIT_FAILURE;
+    }
+
+    uint32_t iterations = argc > 3 ? stoul(argv[3]) : 20;
+
+    unique_ptr<dtNavMeshQuery, NavQueryDeleter> query(dtAllocNavMeshQuery());
+    query->init(mesh.get(), MAX_QUERY_NODES);
+
+    dtQueryFilter virtual_filter;
+    virtual_filter.setIncludeFlags(POLYFLAGS_WALK);
+    virtual_filter.setExcludeFlags(0);
+
+    dtIncludeFlagsFilter<POLYFLAGS_WALK> template_filter;
+
+    FilterRunner<dtQueryFilter> virtual_runner {*query, virtual_filter,
+                                                queries};
+    FilterRunner<dtIncludeFlagsFilter<POLYFLAGS_WALK>> template_runner {
+        *query, template_filter, queries};
+
+    bool mismatch = false;
+    auto compare = [&](const char *name, auto &&virtual_fn,
+                       auto &&template_fn) {
+        if (virtual_fn() != template_fn()) {
+            cerr << name << ": results differ between filters" << endl;
+            mismatch = true;
+        }
+
+        double virtual_ns = timeNs(iterations, queries.size(), virtual_fn);
+        double template_ns = timeNs(iterations, queries.size(), template_fn);
+
+        printf("%-18s virtual %10.1f ns  template %10.1f ns  speedup %.2fx\n",
+               name, virtual_ns, template_ns, virtual_ns / template_ns);
+    };
+
+    printf("%zu queries, %u iterations\n", queries.size(), iterations);
+
+    compare(
+        "findNearestPoly", [&]() { return virtual_runner.snap(); },
+        [&]() { return template_runner.snap(); });
+    compare(
+        "findPath", [&]() { return virtual_runner.findPath(); },
+        [&]() { return template_runner.findPath(); });
+    compare(
+        "moveAlongSurface", [&]() { return virtual_runner.moveAlongSurface(); },
+        [&]() { return template_runner.moveAlongSurface(); });
+
+    return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,772 @@
+// Procedurally generated navmeshes and PointNav episodes, so the navigation
+// benchmarks can run without the Gibson / MP3D scenes and can be scaled to
+// far more polys than any real scene has.
+//
+// A scene is a grid of square walkable cells, possibly stacked into several
+// storeys, with each cell's corners at their own height so ramps can join
+// the storeys. Each cell becomes one quad poly, and cells become neighbours
+// where they share an edge at the same height. The grid is cut into square
+// tiles and each tile's polys are built with dtCreateNavMeshData, the same
+// step Recast's pipeline ends with.
+
+#pragma once
+
+#include "bench_common.h"
+
+#include <DetourCommon.h>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshBuilder.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace NavBench {
+
+struct SyntheticCell {
+    int32_t x;
+    int32_t z;
+    // Corner heights in cellHeight units, at (x, z), (x, z + 1),
+    // (x + 1, z + 1) and (x + 1, z). Edge i runs from corner i to corner
+    // i + 1, so edges 0 to 3 face -x, +z, +x and -z.
+    std::array<uint16_t, 4> y;
+};
+
+struct SyntheticScene {
+    int32_t width = 0;
+    int32_t depth = 0;
+    float cellSize = 0.5f;
+    float cellHeight = 0.05f;
+    std::vector<SyntheticCell> cells;
+};
+
+struct MazeParams {
+    // Maze junctions along each side
+    int32_t size = 16;
+    // Width of the corridors and of the walls between them, in cells
+    int32_t corridorCells = 2;
+    // Chance each wall left by the spanning tree is opened, adding loops
+    float loopFraction = 0.1f;
+};
+
+struct RoomsParams {
+    // Rooms along each side
+    int32_t size = 4;
+    int32_t roomCells = 12;
+    int32_t doorCells = 2;
+    // Chance each wall left by the spanning tree still gets a door
+    float loopFraction = 0.3f;
+};
+
+struct StoreysParams {
+    RoomsParams rooms;
+    int32_t storeys = 3;
+    float storeyHeight = 3.f;
+    // Ramp run and width in cells, the run has to leave a cell free at each
+    // end inside a room
+    int32_t rampCells = 10;
+    int32_t rampWidthCells = 2;
+};
+
+struct EpisodeParams {
+    uint32_t numEpisodes = 1000;
+    float minDistance = 1.f;
+    float maxDistance = 30.f;
+    // Minimum geodesic to euclidean distance ratio, as habitat's PointNav
+    // datasets use to skip trivial straight line episodes
+    float minDistanceRatio = 1.1f;
+};
+
+struct SyntheticEpisode {
+    std::array<float, 3> start;
+    // Quaternion as x, y, z, w
+    std::array<float, 4> startRotation;
+    std::array<float, 3> goal;
+    float geodesicDistance;
+};
+
+namespace Synthetic {
+
+constexpr uint16_t MESH_NULL_IDX = 0xffff;
+constexpr uint16_t PORTAL_FLAG = 0x8000;
+constexpr int VERTS_PER_POLY = 4;
+
+// Matches the PointNav agent
+constexpr float AGENT_HEIGHT = 1.5f;
+constexpr float AGENT_RADIUS = 0.1f;
+constexpr float AGENT_MAX_CLIMB = 0.2f;
+
+// Spanning tree of a width x depth grid of junctions, from a randomized
+// depth first search, plus each remaining wall opened with probability
+// loop_fraction. Bit 0 of a junction's entry opens it to +x, bit 1 to +z.
+inline std::vector<uint8_t> carveMaze(int32_t width,
+                                      int32_t depth,
+                                      float loop_fraction,
+                                      std::mt19937 &rgen)
+{
+    std::vector<uint8_t> open(width * depth, 0);
+    std::vector<uint8_t> visited(width * depth, 0);
+    std::vector<int32_t> stack {0};
+    visited[0] = 1;
+
+    while (!stack.empty()) {
+        int32_t cur = stack.back();
+        int32_t x = cur % width, z = cur / width;
+
+        std::array<int32_t, 4> unvisited;
+        int num_unvisited = 0;
+        auto consider = [&](bool in_bounds, int32_t next) {
+            if (in_bounds && !visited[next]) {
+                unvisited[num_unvisited++] = next;
+            }
+        };
+        consider(x > 0, cur - 1);
+        consider(x < width - 1, cur + 1);
+        consider(z > 0, cur - width);
+        consider(z < depth - 1, cur + width);
+
+        if (num_unvisited == 0) {
+            stack.pop_back();
+            continue;
+        }
+
+        int32_t next = unvisited[std::uniform_int_distribution<int>(
+            0, num_unvisited - 1)(rgen)];
+        int32_t lo = std::min(cur, next), hi = std::max(cur, next);
+        open[lo] |= hi == lo + 1 ? 1 : 2;
+
+        visited[next] = 1;
+        stack.push_back(next);
+    }
+
+    std::uniform_real_distribution<float> unit_dist(0.f, 1.f);
+    for (int32_t z = 0; z < depth; z++) {
+        for (int32_t x = 0; x < width; x++) {
+            uint8_t &junction = open[z * width + x];
+            if (x < width - 1 && unit_dist(rgen) < loop_fraction) {
+                junction |= 1;
+            }
+            if (z < depth - 1 && unit_dist(rgen) < loop_fraction) {
+                junction |= 2;
+            }
+        }
+    }
+
+    return open;
+}
+
+// Rooms separated by one cell thick walls, with a door in the walls the
+// maze opens. Returns which cells of the floor are walkable.
+inline std::vector<uint8_t> makeRoomsFloor(const RoomsParams &params,
+                                           int32_t grid_size,
+                                           std::mt19937 &rgen)
+{
+    std::vector<uint8_t> walkable(grid_size * grid_size, 0);
+    std::vector<uint8_t> doors =
+        carveMaze(params.size, params.size, params.loopFraction, rgen);
+    std::uniform_int_distribution<int32_t> door_offset(
+        0, params.roomCells - params.doorCells);
+
+    const int32_t pitch = params.roomCells + 1;
+    for (int32_t rz = 0; rz < params.size; rz++) {
+        for (int32_t rx = 0; rx < params.size; rx++) {
+            const int32_t x0 = rx * pitch, z0 = rz * pitch;
+            for (int32_t z = z0; z < z0 + params.roomCells; z++) {
+                for (int32_t x = x0; x < x0 + params.roomCells; x++) {
+                    walkable[z * grid_size + x] = 1;
+                }
+            }
+
+            uint8_t open = doors[rz * params.size + rx];
+            if (open & 1) {
+                int32_t z = z0 + door_offset(rgen);
+                for (int32_t i = 0; i < params.doorCells; i++) {
+                    walkable[(z + i) * grid_size + x0 + params.roomCells] = 1;
+                }
+            }
+            if (open & 2) {
+                int32_t x = x0 + door_offset(rgen);
+                for (int32_t i = 0; i < params.doorCells; i++) {
+                    walkable[(z0 + params.roomCells) * grid_size + x + i] = 1;
+                }
+            }
+        }
+    }
+
+    return walkable;
+}
+
+inline void addFlatCells(SyntheticScene &scene,
+                         const std::vector<uint8_t> &walkable,
+                         uint16_t y)
+{
+    for (int32_t z = 0; z < scene.depth; z++) {
+        for (int32_t x = 0; x < scene.width; x++) {
+            if (walkable[z * scene.width + x]) {
+                scene.cells.push_back({x, z, {y, y, y, y}});
+            }
+        }
+    }
+}
+
+// The cells of each grid column, bottom storey first
+struct CellColumns {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> cells;
+
+    explicit CellColumns(const SyntheticScene &scene)
+        : offsets(scene.width * scene.depth + 1, 0),
+          cells(scene.cells.size())
+    {
+        for (const SyntheticCell &cell : scene.cells) {
+            offsets[cell.z * scene.width + cell.x + 1]++;
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+        for (uint32_t i = 0; i < scene.cells.size(); i++) {
+            const SyntheticCell &cell = scene.cells[i];
+            cells[next[cell.z * scene.width + cell.x]++] = i;
+        }
+    }
+};
+
+// The cell sharing edge 0 to 3 of cell idx, or -1 where that edge is a wall
+inline int64_t neighbourCell(const SyntheticScene &scene,
+                             const CellColumns &columns,
+                             uint32_t idx,
+                             int edge)
+{
+    static constexpr int32_t DX[4] = {-1, 0, 1, 0};
+    static constexpr int32_t DZ[4] = {0, 1, 0, -1};
+
+    const SyntheticCell &cell = scene.cells[idx];
+    const int32_t x = cell.x + DX[edge], z = cell.z + DZ[edge];
+    if (x < 0 || z < 0 || x >= scene.width || z >= scene.depth) {
+        return -1;
+    }
+
+    // The neighbour's facing edge runs the other way, from its corner
+    // (edge + 3) % 4 to its corner (edge + 2) % 4
+    const uint16_t a = cell.y[edge], b = cell.y[(edge + 1) % 4];
+    const uint32_t column = z * scene.width + x;
+    for (uint32_t i = columns.offsets[column]; i < columns.offsets[column + 1];
+         i++) {
+        const SyntheticCell &other = scene.cells[columns.cells[i]];
+        if (other.y[(edge + 3) % 4] == a && other.y[(edge + 2) % 4] == b) {
+            return columns.cells[i];
+        }
+    }
+
+    return -1;
+}
+
+inline float cellHeightAt(const SyntheticScene &scene,
+                          const SyntheticCell &cell,
+                          float u,
+                          float v)
+{
+    // Bilinear over the corners, u along x and v along z
+    float y0 = cell.y[0] + (cell.y[1] - cell.y[0]) * v;
+    float y1 = cell.y[3] + (cell.y[2] - cell.y[3]) * v;
+    return (y0 + (y1 - y0) * u) * scene.cellHeight;
+}
+
+}  // namespace Synthetic
+
+// A grid maze with corridors corridorCells wide
+inline SyntheticScene makeMazeScene(const MazeParams &params, uint32_t seed)
+{
+    std::mt19937 rgen(seed);
+    std::vector<uint8_t> open =
+        Synthetic::carveMaze(params.size, params.size, params.loopFraction,
+                             rgen);
+
+    const int32_t c = params.corridorCells;
+    SyntheticScene scene;
+    scene.width = scene.depth = (2 * params.size - 1) * c;
+
+    std::vector<uint8_t> walkable(scene.width * scene.depth, 0);
+    auto fill_block = [&](int32_t bx, int32_t bz) {
+        for (int32_t z = bz * c; z < (bz + 1) * c; z++) {
+            for (int32_t x = bx * c; x < (bx + 1) * c; x++) {
+                walkable[z * scene.width + x] = 1;
+            }
+        }
+    };
+
+    for (int32_t z = 0; z < params.size; z++) {
+        for (int32_t x = 0; x < params.size; x++) {
+            fill_block(2 * x, 2 * z);
+            uint8_t junction = open[z * params.size + x];
+            if (junction & 1) {
+                fill_block(2 * x + 1, 2 * z);
+            }
+            if (junction & 2) {
+                fill_block(2 * x, 2 * z + 1);
+            }
+        }
+    }
+
+    Synthetic::addFlatCells(scene, walkable, 0);
+
+    return scene;
+}
+
+// A single floor of rooms joined by doors
+inline SyntheticScene makeRoomsScene(const RoomsParams &params, uint32_t seed)
+{
+    std::mt19937 rgen(seed);
+
+    SyntheticScene scene;
+    scene.width = scene.depth = params.size * (params.roomCells + 1) - 1;
+    Synthetic::addFlatCells(
+        scene, Synthetic::makeRoomsFloor(params, scene.width, rgen), 0);
+
+    return scene;
+}
+
+// Floors of rooms stacked storeyHeight apart, each joined to the next by a
+// ramp inside one of its rooms. The floor above has a hole over the ramp.
+// Returns an empty scene if the rooms can't fit the ramps.
+inline SyntheticScene makeStoreysScene(const StoreysParams &params,
+                                       uint32_t seed)
+{
+    const RoomsParams &rooms = params.rooms;
+    SyntheticScene scene;
+    if (params.rampCells + 2 > rooms.roomCells ||
+        params.rampWidthCells > rooms.roomCells ||
+        (params.storeys > 2 && rooms.size * rooms.size < 2)) {
+        return scene;
+    }
+
+    std::mt19937 rgen(seed);
+    scene.width = scene.depth = rooms.size * (rooms.roomCells + 1) - 1;
+
+    const int32_t pitch = rooms.roomCells + 1;
+    const int32_t run = params.rampCells;
+    const int32_t storey_y = std::lround(params.storeyHeight /
+                                         scene.cellHeight);
+
+    std::uniform_int_distribution<int32_t> room_dist(
+        0, rooms.size * rooms.size - 1);
+    std::uniform_int_distribution<int32_t> ramp_x_dist(
+        1, rooms.roomCells - run - 1);
+    std::uniform_int_distribution<int32_t> ramp_z_dist(
+        0, rooms.roomCells - params.rampWidthCells);
+
+    int32_t prev_room = -1, prev_x = 0, prev_z = 0;
+    for (int32_t storey = 0; storey < params.storeys; storey++) {
+        std::vector<uint8_t> walkable =
+            Synthetic::makeRoomsFloor(rooms, scene.width, rgen);
+        const int32_t base = storey * storey_y;
+
+        auto for_ramp_cells = [&](int32_t ramp_x, int32_t ramp_z,
+                                  auto &&fn) {
+            for (int32_t z = ramp_z; z < ramp_z + params.rampWidthCells;
+                 z++) {
+                for (int32_t x = ramp_x; x < ramp_x + run; x++) {
+                    fn(x, z);
+                }
+            }
+        };
+
+        // The hole over the ramp up from the storey below
+        if (prev_room >= 0) {
+            for_ramp_cells(prev_x, prev_z, [&](int32_t x, int32_t z) {
+                walkable[z * scene.width + x] = 0;
+            });
+        }
+
+        if (storey < params.storeys - 1) {
+            int32_t room;
+            do {
+                room = room_dist(rgen);
+            } while (room == prev_room);
+
+            int32_t ramp_x = (room % rooms.size) * pitch + ramp_x_dist(rgen);
+            int32_t ramp_z = (room / rooms.size) * pitch + ramp_z_dist(rgen);
+
+            // Rises along +x, from this storey at ramp_x to the next at
+            // ramp_x + run
+            auto height = [&](int32_t x) {
+                int32_t step = x - ramp_x;
+                return uint16_t(base + (step * storey_y + run / 2) / run);
+            };
+
+            for_ramp_cells(ramp_x, ramp_z, [&](int32_t x, int32_t z) {
+                walkable[z * scene.width + x] = 0;
+                uint16_t lo = height(x), hi = height(x + 1);
+                scene.cells.push_back({x, z, {lo, lo, hi, hi}});
+            });
+
+            prev_room = room;
+            prev_x = ramp_x;
+            prev_z = ramp_z;
+        }
+
+        Synthetic::addFlatCells(scene, walkable, base);
+    }
+
+    return scene;
+}
+
+// Builds the scene's navmesh in tiles of tile_cells x tile_cells cells.
+// Returns null if a tile has too many polys or vertices for
+// dtCreateNavMeshData, or the tile and poly counts don't fit in a
+// dtPolyRef, either way a smaller tile_cells may fit.
+inline std::unique_ptr<dtNavMesh, NavMeshDeleter> buildSyntheticNavMesh(
+    const SyntheticScene &scene,
+    int32_t tile_cells)
+{
+    using namespace Synthetic;
+
+    const CellColumns columns(scene);
+    const int32_t tiles_x = (scene.width + tile_cells - 1) / tile_cells;
+    const int32_t tiles_z = (scene.depth + tile_cells - 1) / tile_cells;
+    const float tile_size = tile_cells * scene.cellSize;
+
+    auto tile_of = [&](const SyntheticCell &cell) {
+        return (cell.z / tile_cells) * tiles_x + cell.x / tile_cells;
+    };
+
+    std::vector<std::vector<uint32_t>> tile_cell_lists(tiles_x * tiles_z);
+    std::vector<uint32_t> local_idx(scene.cells.size());
+    uint16_t max_y = 0;
+    for (uint32_t i = 0; i < scene.cells.size(); i++) {
+        const SyntheticCell &cell = scene.cells[i];
+        auto &tile_cell_list = tile_cell_lists[tile_of(cell)];
+        local_idx[i] = tile_cell_list.size();
+        tile_cell_list.push_back(i);
+        max_y = std::max(max_y, *std::max_element(cell.y.begin(),
+                                                  cell.y.end()));
+    }
+
+    size_t max_tile_polys = 1;
+    int num_tiles = 0;
+    for (const auto &cells : tile_cell_lists) {
+        max_tile_polys = std::max(max_tile_polys, cells.size());
+        num_tiles += !cells.empty();
+    }
+
+    if (max_tile_polys >= PORTAL_FLAG || num_tiles == 0) {
+        return nullptr;
+    }
+
+    dtNavMeshParams mesh_params;
+    mesh_params.orig[0] = 0.f;
+    mesh_params.orig[1] = 0.f;
+    mesh_params.orig[2] = 0.f;
+    mesh_params.tileWidth = tile_size;
+    mesh_params.tileHeight = tile_size;
+    mesh_params.maxTiles = dtNextPow2(num_tiles);
+    mesh_params.maxPolys = dtNextPow2(max_tile_polys);
+
+    if (dtIlog2(mesh_params.maxTiles) + dtIlog2(mesh_params.maxPolys) > 22) {
+        return nullptr;
+    }
+
+    std::unique_ptr<dtNavMesh, NavMeshDeleter> mesh(dtAllocNavMesh());
+    if (!mesh || dtStatusFailed(mesh->init(&mesh_params))) {
+        return nullptr;
+    }
+
+    static constexpr int CORNER_DX[4] = {0, 0, 1, 1};
+    static constexpr int CORNER_DZ[4] = {0, 1, 1, 0};
+
+    std::vector<uint16_t> verts, polys, flags;
+    std::vector<uint8_t> areas;
+    std::unordered_map<uint64_t, uint16_t> vert_ids;
+
+    for (int32_t tz = 0; tz < tiles_z; tz++) {
+        for (int32_t tx = 0; tx < tiles_x; tx++) {
+            const auto &cells = tile_cell_lists[tz * tiles_x + tx];
+            if (cells.empty()) {
+                continue;
+            }
+
+            verts.clear();
+            vert_ids.clear();
+            polys.assign(cells.size() * VERTS_PER_POLY * 2, MESH_NULL_IDX);
+            flags.assign(cells.size(), POLYFLAGS_WALK);
+            areas.assign(cells.size(), 0);
+
+            for (size_t p = 0; p < cells.size(); p++) {
+                const SyntheticCell &cell = scene.cells[cells[p]];
+                uint16_t *poly = &polys[p * VERTS_PER_POLY * 2];
+
+                for (int corner = 0; corner < 4; corner++) {
+                    // Relative to the tile, the tile's far edges are at
+                    // tile_cells
+                    uint16_t x = cell.x - tx * tile_cells + CORNER_DX[corner];
+                    uint16_t z = cell.z - tz * tile_cells + CORNER_DZ[corner];
+                    uint16_t y = cell.y[corner];
+                    uint64_t key = uint64_t(x) << 32 | uint64_t(y) << 16 | z;
+
+                    auto [iter, inserted] = vert_ids.emplace(
+                        key, uint16_t(verts.size() / 3));
+                    if (inserted) {
+                        if (verts.size() / 3 >= MESH_NULL_IDX) {
+                            return nullptr;
+                        }
+                        verts.insert(verts.end(), {x, y, z});
+                    }
+                    poly[corner] = iter->second;
+                }
+
+                for (int edge = 0; edge < 4; edge++) {
+                    int64_t other =
+                        neighbourCell(scene, columns, cells[p], edge);
+                    if (other < 0) {
+                        continue;
+                    }
+
+                    // Edges on the tile border are portals, which
+                    // dtNavMesh links to the neighbouring tile's polys.
+                    // Portal sides 0 to 3 face -x, +z, +x and -z, like
+                    // the edges.
+                    if (tile_of(scene.cells[other]) != tz * tiles_x + tx) {
+                        poly[VERTS_PER_POLY + edge] = PORTAL_FLAG | edge;
+                    } else {
+                        poly[VERTS_PER_POLY + edge] = local_idx[other];
+                    }
+                }
+            }
+
+            dtNavMeshCreateParams params;
+            memset(&params, 0, sizeof(params));
+            params.verts = verts.data();
+            params.vertCount = verts.size() / 3;
+            params.polys = polys.data();
+            params.polyFlags = flags.data();
+            params.polyAreas = areas.data();
+            params.polyCount = cells.size();
+            params.nvp = VERTS_PER_POLY;
+            params.tileX = tx;
+            params.tileY = tz;
+            params.bmin[0] = tx * tile_size;
+            params.bmin[1] = 0.f;
+            params.bmin[2] = tz * tile_size;
+            params.bmax[0] = (tx + 1) * tile_size;
+            params.bmax[1] = max_y * scene.cellHeight + AGENT_HEIGHT;
+            params.bmax[2] = (tz + 1) * tile_size;
+            params.walkableHeight = AGENT_HEIGHT;
+            params.walkableRadius = AGENT_RADIUS;
+            params.walkableClimb = AGENT_MAX_CLIMB;
+            params.cs = scene.cellSize;
+            params.ch = scene.cellHeight;
+            params.buildBvTree = true;
+
+            unsigned char *data = nullptr;
+            int data_size = 0;
+            if (!dtCreateNavMeshData(&params, &data, &data_size)) {
+                return nullptr;
+            }
+
+            if (dtStatusFailed(mesh->addTile(data, data_size,
+                                             DT_TILE_FREE_DATA, 0,
+                                             nullptr))) {
+                dtFree(data);
+                return nullptr;
+            }
+        }
+    }
+
+    return mesh;
+}
+
+// Writes the navmesh in PathFinder's on disk format
+inline bool writeNavMesh(const dtNavMesh &mesh, const std::string &path)
+{
+    std::unique_ptr<FILE, decltype(&fclose)> file(fopen(path.c_str(), "wb"),
+                                                  &fclose);
+    if (!file) {
+        return false;
+    }
+
+    NavMeshSetHeader header;
+    header.magic = NAVMESHSET_MAGIC;
+    header.version = NAVMESHSET_VERSION;
+    header.numTiles = 0;
+    for (int i = 0; i < mesh.getMaxTiles(); i++) {
+        const dtMeshTile *tile = mesh.getTile(i);
+        header.numTiles += tile && tile->header && tile->dataSize > 0;
+    }
+    memcpy(&header.params, mesh.getParams(), sizeof(dtNavMeshParams));
+
+    if (fwrite(&header, sizeof(header), 1, file.get()) != 1) {
+        return false;
+    }
+
+    for (int i = 0; i < mesh.getMaxTiles(); i++) {
+        const dtMeshTile *tile = mesh.getTile(i);
+        if (!tile || !tile->header || tile->dataSize <= 0) {
+            continue;
+        }
+
+        NavMeshTileHeader tile_header {mesh.getTileRef(tile), tile->dataSize};
+        if (fwrite(&tile_header, sizeof(tile_header), 1, file.get()) != 1 ||
+            fwrite(tile->data, tile->dataSize, 1, file.get()) != 1) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// PointNav episodes between random points of the scene's largest connected
+// area. geodesic(start, goal) gives the distance between two points, or a
+// negative distance if there's no path, so the distances and the episodes
+// kept match whatever will navigate them. May return fewer than numEpisodes
+// if the scene has too few pairs within the distance limits.
+template <typename GeodesicFn>
+std::vector<SyntheticEpisode> makeSyntheticEpisodes(
+    const SyntheticScene &scene,
+    const EpisodeParams &params,
+    uint32_t seed,
+    GeodesicFn &&geodesic)
+{
+    using namespace Synthetic;
+
+    // Largest set of cells joined by shared edges, so every start can reach
+    // every goal
+    const CellColumns columns(scene);
+    std::vector<uint32_t> parent(scene.cells.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&](uint32_t i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+
+    for (uint32_t i = 0; i < scene.cells.size(); i++) {
+        for (int edge = 1; edge <= 2; edge++) {
+            int64_t other = neighbourCell(scene, columns, i, edge);
+            if (other >= 0) {
+                parent[find(i)] = find(other);
+            }
+        }
+    }
+
+    std::vector<uint32_t> component_size(scene.cells.size(), 0);
+    for (uint32_t i = 0; i < scene.cells.size(); i++) {
+        component_size[find(i)]++;
+    }
+    const uint32_t largest = std::max_element(component_size.begin(),
+                                              component_size.end()) -
+                             component_size.begin();
+
+    std::vector<uint32_t> candidates;
+    for (uint32_t i = 0; i < scene.cells.size(); i++) {
+        if (find(i) == largest) {
+            candidates.push_back(i);
+        }
+    }
+
+    std::vector<SyntheticEpisode> episodes;
+    if (candidates.empty()) {
+        return episodes;
+    }
+
+    std::mt19937 rgen(seed);
+    std::uniform_int_distribution<size_t> cell_dist(0, candidates.size() - 1);
+    // Keeps points off the cell edges, so they snap to their own cell
+    std::uniform_real_distribution<float> offset_dist(0.1f, 0.9f);
+    std::uniform_real_distribution<float> angle_dist(0.f, 2.f * float(M_PI));
+
+    auto random_point = [&]() {
+        const SyntheticCell &cell = scene.cells[candidates[cell_dist(rgen)]];
+        float u = offset_dist(rgen), v = offset_dist(rgen);
+        return std::array<float, 3> {(cell.x + u) * scene.cellSize,
+                                     cellHeightAt(scene, cell, u, v),
+                                     (cell.z + v) * scene.cellSize};
+    };
+
+    const uint64_t max_attempts = uint64_t(params.numEpisodes) * 1000;
+    for (uint64_t attempt = 0;
+         attempt < max_attempts && episodes.size() < params.numEpisodes;
+         attempt++) {
+        SyntheticEpisode episode;
+        episode.start = random_point();
+        episode.goal = random_point();
+
+        float distance = geodesic(episode.start, episode.goal);
+        float euclidean = dtVdist(episode.start.data(), episode.goal.data());
+        if (distance < 0.f || distance < params.minDistance ||
+            distance > params.maxDistance ||
+            distance < params.minDistanceRatio * euclidean) {
+            continue;
+        }
+
+        float yaw = angle_dist(rgen);
+        episode.startRotation = {0.f, sinf(yaw / 2.f), 0.f, cosf(yaw / 2.f)};
+        episode.geodesicDistance = distance;
+        episodes.push_back(episode);
+    }
+
+    return episodes;
+}
+
+// Writes the episodes as a gzipped PointNav dataset file for scene_id, the
+// format loadQueries and the simulator read
+inline bool writeEpisodes(const std::vector<SyntheticEpisode> &episodes,
+                          const std::string &scene_id,
+                          const std::string &path)
+{
+    // Round trips the floats exactly, on grids of equal cells a slightly
+    // different start or goal can tip findPath's search onto a different,
+    // longer corridor
+    std::ostringstream json;
+    json.precision(std::numeric_limits<float>::max_digits10);
+
+    auto write_array = [&](const auto &arr) {
+        json << '[';
+        for (size_t i = 0; i < arr.size(); i++) {
+            json << (i > 0 ? ", " : "") << arr[i];
+        }
+        json << ']';
+    };
+
+    json << "{\"episodes\": [";
+    for (size_t i = 0; i < episodes.size(); i++) {
+        const SyntheticEpisode &episode = episodes[i];
+        json << (i > 0 ? ", " : "") << "{\"episode_id\": \"" << i
+             << "\", \"scene_id\": \"" << scene_id
+             << "\", \"start_position\": ";
+        write_array(episode.start);
+        json << ", \"start_rotation\": ";
+        write_array(episode.startRotation);
+        json << ", \"info\": {\"geodesic_distance\": "
+             << episode.geodesicDistance
+             << "}, \"goals\": [{\"position\": ";
+        write_array(episode.goal);
+        json << ", \"radius\": null}]}";
+    }
+    json << "]}";
+
+    gzFile gz = gzopen(path.c_str(), "wb");
+    if (gz == nullptr) {
+        return false;
+    }
+
+    const std::string data = json.str();
+    bool written = gzwrite(gz, data.data(), data.size()) == int(data.size());
+
+    return gzclose(gz) == Z_OK && written;
+}
+
+}
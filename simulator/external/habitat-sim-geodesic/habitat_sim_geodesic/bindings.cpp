@@ -2,7 +2,8 @@
 <%
 setup_pybind11(cfg)
 
-cfg['compiler_args'] = ['-std=c++14', '-O2', '-g', '-DDT_VIRTUAL_QUERYFILTER']
+cfg['compiler_args'] = ['-std=c++17', '-O2', '-g', '-DDT_VIRTUAL_QUERYFILTER',
+                       '-DDT_STAMPED_NODEPOOL']
 
 cfg['sources'] = ['./csrc/recastnavigation-master/Detour/Source/DetourNode.cpp',
                   './csrc/recastnavigation-master/Detour/Source/DetourAlloc.cpp',
@@ -11,9 +12,11 @@ cfg['sources'] = ['./csrc/recastnavigation-master/Detour/Source/DetourNode.cpp',
                   './csrc/recastnavigation-master/Detour/Source/DetourNavMesh.cpp',
                   './csrc/recastnavigation-master/Detour/Source/DetourNavMeshQuery.cpp',
                   './csrc/recastnavigation-master/Detour/Source/DetourNavMeshBuilder.cpp',
+                  './csrc/recastnavigation-master/DetourCrowd/Source/DetourPathCorridor.cpp',
                   './csrc/PathFinder.cpp',]
 
 cfg['include_dirs'] = ['./csrc/recastnavigation-master/Detour/Include',
+                       './csrc/recastnavigation-master/DetourCrowd/Include',
                        './csrc/eigen',
                        './csrc/eigen/Eigen',
                        './csrc',]
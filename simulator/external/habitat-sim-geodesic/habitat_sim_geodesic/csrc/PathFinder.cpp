@@ -3,33 +3,59 @@
 // LICENSE file in the root directory of this source tree.
 
 #include "PathFinder.h"
-#include <stack>
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
 
+#include <cfloat>
 #include <cstdio>
+#include <cstring>
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <limits>
+#include <mutex>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "DetourNavMesh.h"
 #include "DetourNavMeshBuilder.h"
 #include "DetourNavMeshQuery.h"
 #include "DetourNode.h"
+#include "DetourPathCorridor.h"
 
 namespace esp {
 namespace nav {
 
 namespace {
+enum PolyAreas { POLYAREA_GROUND, POLYAREA_DOOR };
+
+enum PolyFlags {
+  POLYFLAGS_WALK = 0x01,      // walkable
+  POLYFLAGS_DOOR = 0x02,      // ability to move through doors
+  POLYFLAGS_DISABLED = 0x04,  // disabled polygon
+  POLYFLAGS_ALL = 0xffff      // all abilities
+};
+
+// All of PathFinder's queries only include walkable polygons at their default
+// (distance) cost. Using this filter instead of a dtQueryFilter selects the
+// templated dtNavMeshQuery searches, where the filter checks inline to a flag
+// test instead of being virtual calls per neighbour expansion.
+using WalkFilter = dtIncludeFlagsFilter<POLYFLAGS_WALK>;
+const WalkFilter walkFilter{};
+
 template <typename T>
 std::tuple<dtStatus, dtPolyRef, vec3f> projectToPoly(
     const T& pt,
     const dtNavMeshQuery* navQuery,
-    const dtQueryFilter* filter) {
+    const WalkFilter* filter) {
   // Defines size of the bounding box to search in for the nearest polygon. If
   // there is no polygon inside the bounding box, the status is set to failure
   // and polyRef == 0
   constexpr float polyPickExt[3] = {2, 4, 2};  // [2 * dx, 2 * dy, 2 * dz]
-  dtPolyRef polyRef;
+  dtPolyRef polyRef = 0;
   // Initialize with all NANs at dtStatusSucceed(status) == true does NOT mean
   // that it found a point to project to..........
   vec3f polyXYZ{NAN, NAN, NAN};
@@ -46,111 +72,167 @@ std::tuple<dtStatus, dtPolyRef, vec3f> projectToPoly(
 
 namespace impl {
 
+// Maps poly refs to dense indices in [0, numPolys()), so per-poly data can be
+// kept in flat arrays instead of being keyed by dtPolyRef
+class PolyIndex {
+ public:
+  explicit PolyIndex(const dtNavMesh* navMesh)
+      : navMesh_(navMesh), tileBase_(navMesh->getMaxTiles(), 0) {
+    numPolys_ = 0;
+    for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+      tileBase_[iTile] = numPolys_;
+
+      const dtMeshTile* tile = navMesh->getTile(iTile);
+      if (!tile || !tile->header)
+        continue;
+
+      numPolys_ += tile->header->polyCount;
+    }
+  }
+
+  inline uint32_t index(dtPolyRef ref) const {
+    unsigned int salt, iTile, iPoly;
+    navMesh_->decodePolyId(ref, salt, iTile, iPoly);
+    return tileBase_[iTile] + iPoly;
+  }
+
+  inline uint32_t numPolys() const { return numPolys_; }
+
+  inline bool isValid(dtPolyRef ref) const {
+    return navMesh_->isValidPolyRef(ref);
+  }
+
+ private:
+  const dtNavMesh* navMesh_;
+  std::vector<uint32_t> tileBase_;
+  uint32_t numPolys_;
+};
+
 // Runs connected component analysis on the navmesh to figure out which polygons
 // are connected This gives O(1) lookup for if a path between two polygons
 // exists or not
 // Takes O(npolys) to construct
+//
+// Islands are stored in a flat array indexed by PolyIndex, so lookups are a
+// poly ref decode and an array read.
 class IslandSystem {
  public:
-  IslandSystem(const dtNavMesh* navMesh, const dtQueryFilter* filter) {
-    std::vector<vec3f> islandVerts;
+  IslandSystem(const dtNavMesh* navMesh,
+               const PolyIndex& polyIndex,
+               const dtQueryFilter* filter)
+      : polyIndex_(polyIndex),
+        polyToIsland_(polyIndex.numPolys(), NO_ISLAND) {
+    std::vector<dtPolyRef> stack;
+    std::vector<dtPolyRef> islandPolys;
 
     // Iterate over all tiles
     for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
       const dtMeshTile* tile = navMesh->getTile(iTile);
-      if (!tile)
+      if (!tile || !tile->header)
         continue;
 
       // Iterate over all polygons in a tile
       for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
         // Get the polygon reference from the tile and polygon id
-        dtPolyRef startRef = navMesh->encodePolyId(iTile, tile->salt, jPoly);
+        dtPolyRef startRef = navMesh->encodePolyId(tile->salt, iTile, jPoly);
 
         // If the polygon ref is valid, and we haven't seen it yet,
         // start connected component analysis from this polygon
         if (navMesh->isValidPolyRef(startRef) &&
-            (polyToIsland_.find(startRef) == polyToIsland_.end())) {
+            polyToIsland_[polyIndex_.index(startRef)] == NO_ISLAND) {
           uint32_t newIslandId = islandRadius_.size();
-          expandFrom(navMesh, filter, newIslandId, startRef, islandVerts);
-
-          // The radius is calculated as the max deviation from the
-          // mean for all points in the island
-          vec3f centroid = vec3f::Zero();
-          for (auto& v : islandVerts) {
-            centroid += v;
-          }
-          centroid /= islandVerts.size();
+          expandFrom(navMesh, filter, newIslandId, startRef, stack,
+                     islandPolys);
 
-          float maxRadius = 0.0;
-          for (auto& v : islandVerts) {
-            maxRadius = std::max(maxRadius, (v - centroid).norm());
-          }
-
-          islandRadius_.emplace_back(maxRadius);
+          islandRadius_.emplace_back(radius(navMesh, islandPolys));
         }
       }
     }
   }
 
+  // Restores islands computed by the other constructor, see polyIslands and
+  // islandRadii
+  IslandSystem(const PolyIndex& polyIndex,
+               std::vector<uint32_t> polyToIsland,
+               std::vector<float> islandRadius)
+      : polyIndex_(polyIndex),
+        polyToIsland_(std::move(polyToIsland)),
+        islandRadius_(std::move(islandRadius)) {}
+
+  // Island of each poly, in PolyIndex order
+  inline const std::vector<uint32_t>& polyIslands() const {
+    return polyToIsland_;
+  }
+
+  inline const std::vector<float>& islandRadii() const {
+    return islandRadius_;
+  }
+
   inline bool hasConnection(dtPolyRef startRef, dtPolyRef endRef) const {
     // If both polygons are on the same island, there must be a path between
     // them
-    auto itStart = polyToIsland_.find(startRef);
-    if (itStart == polyToIsland_.end())
+    const uint32_t startIsland = islandOf(startRef);
+    if (startIsland == NO_ISLAND)
       return false;
 
-    auto itEnd = polyToIsland_.find(endRef);
-    if (itEnd == polyToIsland_.end())
-      return false;
-
-    return itStart->second == itEnd->second;
+    return startIsland == islandOf(endRef);
   }
 
   inline float islandRadius(dtPolyRef ref) const {
-    auto itRef = polyToIsland_.find(ref);
-    if (itRef == polyToIsland_.end())
+    const uint32_t island = islandOf(ref);
+    if (island == NO_ISLAND)
       return 0.0;
 
-    return islandRadius_[itRef->second];
+    return islandRadius_[island];
   }
 
  private:
-  std::unordered_map<dtPolyRef, uint32_t> polyToIsland_;
+  static constexpr uint32_t NO_ISLAND = std::numeric_limits<uint32_t>::max();
+
+  const PolyIndex& polyIndex_;
+  std::vector<uint32_t> polyToIsland_;
   std::vector<float> islandRadius_;
 
+  inline uint32_t islandOf(dtPolyRef ref) const {
+    if (!polyIndex_.isValid(ref))
+      return NO_ISLAND;
+
+    return polyToIsland_[polyIndex_.index(ref)];
+  }
+
+  // Depth first search from startRef, collecting the polys of the island in
+  // visit order
   void expandFrom(const dtNavMesh* navMesh,
                   const dtQueryFilter* filter,
                   const uint32_t newIslandId,
-                  const dtPolyRef& startRef,
-                  std::vector<vec3f>& islandVerts) {
-    polyToIsland_.emplace(startRef, newIslandId);
-    islandVerts.clear();
-
-    // Force std::stack to be implemented via an std::vector as linked
-    // lists are gross
-    std::stack<dtPolyRef, std::vector<dtPolyRef>> stack;
-
-    // Add the start ref to the stack
-    stack.push(startRef);
+                  const dtPolyRef startRef,
+                  std::vector<dtPolyRef>& stack,
+                  std::vector<dtPolyRef>& islandPolys) {
+    polyToIsland_[polyIndex_.index(startRef)] = newIslandId;
+    islandPolys.clear();
+
+    stack.clear();
+    stack.push_back(startRef);
     while (!stack.empty()) {
-      dtPolyRef ref = stack.top();
-      stack.pop();
+      dtPolyRef ref = stack.back();
+      stack.pop_back();
+      islandPolys.push_back(ref);
 
       const dtMeshTile* tile = 0;
       const dtPoly* poly = 0;
       navMesh->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
 
-      for (int iVert = 0; iVert < poly->vertCount; ++iVert) {
-        islandVerts.emplace_back(
-            Eigen::Map<vec3f>(&tile->verts[poly->verts[iVert] * 3]));
-      }
-
       // Iterate over all neighbours
       for (unsigned int iLink = poly->firstLink; iLink != DT_NULL_LINK;
            iLink = tile->links[iLink].next) {
         dtPolyRef neighbourRef = tile->links[iLink].ref;
+        if (!neighbourRef)
+          continue;
+
         // If we've already visited this poly, skip it!
-        if (polyToIsland_.find(neighbourRef) != polyToIsland_.end())
+        uint32_t& neighbourIsland =
+            polyToIsland_[polyIndex_.index(neighbourRef)];
+        if (neighbourIsland != NO_ISLAND)
           continue;
 
         const dtMeshTile* neighbourTile = 0;
@@ -162,14 +244,587 @@ class IslandSystem {
         if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
           continue;
 
-        polyToIsland_.emplace(neighbourRef, newIslandId);
-        stack.push(neighbourRef);
+        neighbourIsland = newIslandId;
+        stack.push_back(neighbourRef);
+      }
+    }
+  }
+
+  // The radius is calculated as the max deviation from the mean for all
+  // vertices of all polys in the island
+  static float radius(const dtNavMesh* navMesh,
+                      const std::vector<dtPolyRef>& islandPolys) {
+    vec3f centroid = vec3f::Zero();
+    int numVerts = 0;
+    for (dtPolyRef ref : islandPolys) {
+      const dtMeshTile* tile = 0;
+      const dtPoly* poly = 0;
+      navMesh->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+      for (int iVert = 0; iVert < poly->vertCount; ++iVert) {
+        centroid +=
+            Eigen::Map<const vec3f>(&tile->verts[poly->verts[iVert] * 3]);
+      }
+      numVerts += poly->vertCount;
+    }
+    centroid /= static_cast<float>(numVerts);
+
+    float maxRadius = 0.0;
+    for (dtPolyRef ref : islandPolys) {
+      const dtMeshTile* tile = 0;
+      const dtPoly* poly = 0;
+      navMesh->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+      for (int iVert = 0; iVert < poly->vertCount; ++iVert) {
+        const vec3f v =
+            Eigen::Map<const vec3f>(&tile->verts[poly->verts[iVert] * 3]);
+        maxRadius = std::max(maxRadius, (v - centroid).norm());
       }
     }
+
+    return maxRadius;
   }
 };
+
+// Lower bounds on path costs for the A* search in findPath, using landmarks
+// and the triangle inequality (ALT). For each of a few landmark polys, the
+// tables hold the range of search costs from the landmark to each poly.
+// The cost from any poly to another is then at least the difference of
+// their costs from a landmark.
+//
+// Costs are measured the way dtNavMeshQuery::findPath measures them. The
+// search moves between edge midpoints, and a poly's search node sits at the
+// midpoint of the edge it was first reached through. So each poly has a few
+// candidate node positions, and a poly's range covers the shortest costs
+// from the landmark to all of them. The search can step from any candidate
+// position of a poly to any candidate position of a neighbour, and these
+// costs are taken over that graph.
+//
+// Takes O(numLandmarks * npolys * log(npolys)) to construct, so it is built
+// offline and stored with the navmesh (see PathFinder::packNavMeshes).
+class LandmarkSystem {
+ public:
+  // Range of costs from a landmark to a poly. Polys the landmark can't reach
+  // get an unbounded range, so that they never contribute to an estimate.
+  struct Bounds {
+    float lo;
+    float hi;
+  };
+
+  LandmarkSystem(const dtNavMesh* navMesh,
+                 const dtNavMeshQuery* navQuery,
+                 const PolyIndex& polyIndex,
+                 const IslandSystem& islandSystem,
+                 int maxLandmarks)
+      : polyIndex_(polyIndex), numLandmarks_(0) {
+    const SearchGraph graph(navMesh, navQuery, polyIndex);
+    const uint32_t numPolys = polyIndex.numPolys();
+
+    // Landmarks are spread over the largest island, which is where the long
+    // searches are. Searches elsewhere fall back to the straight line
+    // distance.
+    const std::vector<uint32_t>& polyIslands = islandSystem.polyIslands();
+    std::vector<uint32_t> islandSize(islandSystem.islandRadii().size(), 0);
+    for (uint32_t island : polyIslands) {
+      if (island < islandSize.size())
+        ++islandSize[island];
+    }
+    if (islandSize.empty())
+      return;
+    const uint32_t largestIsland =
+        std::max_element(islandSize.begin(), islandSize.end()) -
+        islandSize.begin();
+
+    uint32_t seedPoly = numPolys;
+    for (uint32_t iPoly = 0; iPoly < numPolys; ++iPoly) {
+      if (polyIslands[iPoly] == largestIsland && graph.numPositions(iPoly)) {
+        seedPoly = iPoly;
+        break;
+      }
+    }
+    if (seedPoly == numPolys)
+      return;
+
+    // Farthest point selection: each landmark is the poly farthest from the
+    // landmarks chosen so far, starting from the poly farthest from an
+    // arbitrary one
+    std::vector<float> costs;
+    std::vector<Bounds> polyBounds;
+    graph.costsFrom(seedPoly, costs);
+    graph.polyBounds(costs, polyBounds);
+
+    std::vector<float> score(numPolys);
+    for (uint32_t iPoly = 0; iPoly < numPolys; ++iPoly)
+      score[iPoly] = reachable(polyBounds[iPoly]) ? polyBounds[iPoly].lo : 0;
+
+    std::vector<std::vector<Bounds>> landmarkBounds;
+    while (static_cast<int>(landmarkBounds.size()) < maxLandmarks) {
+      const uint32_t landmark =
+          std::max_element(score.begin(), score.end()) - score.begin();
+      if (score[landmark] <= 0)
+        break;
+
+      graph.costsFrom(landmark, costs);
+      graph.polyBounds(costs, polyBounds);
+      for (uint32_t iPoly = 0; iPoly < numPolys; ++iPoly) {
+        if (reachable(polyBounds[iPoly]))
+          score[iPoly] = std::min(score[iPoly], polyBounds[iPoly].lo);
+      }
+
+      landmarkBounds.push_back(polyBounds);
+    }
+
+    numLandmarks_ = landmarkBounds.size();
+    bounds_.resize(numPolys * numLandmarks_);
+    for (uint32_t iPoly = 0; iPoly < numPolys; ++iPoly) {
+      for (int iLandmark = 0; iLandmark < numLandmarks_; ++iLandmark) {
+        bounds_[iPoly * numLandmarks_ + iLandmark] =
+            landmarkBounds[iLandmark][iPoly];
+      }
+    }
+  }
+
+  // Restores tables computed by the other constructor, see bounds
+  LandmarkSystem(const PolyIndex& polyIndex,
+                 int numLandmarks,
+                 std::vector<Bounds> bounds)
+      : polyIndex_(polyIndex),
+        numLandmarks_(numLandmarks),
+        bounds_(std::move(bounds)) {}
+
+  inline int numLandmarks() const { return numLandmarks_; }
+
+  // Every landmark's bounds for each poly in turn, in PolyIndex order
+  inline const std::vector<Bounds>& bounds() const { return bounds_; }
+
+  inline const Bounds* polyBounds(dtPolyRef ref) const {
+    return &bounds_[polyIndex_.index(ref) * numLandmarks_];
+  }
+
+ private:
+  // The moves dtNavMeshQuery::findPath can make through walkable polys
+  class SearchGraph {
+   public:
+    SearchGraph(const dtNavMesh* navMesh,
+                const dtNavMeshQuery* navQuery,
+                const PolyIndex& polyIndex)
+        : firstPosition_(polyIndex.numPolys() + 1, 0),
+          firstNeighbour_(polyIndex.numPolys() + 1, 0) {
+      std::vector<std::pair<uint32_t, vec3f>> arrivals;
+      std::vector<std::pair<uint32_t, uint32_t>> adjacent;
+
+      for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
+        const dtMeshTile* tile = navMesh->getTile(iTile);
+        if (!tile || !tile->header)
+          continue;
+
+        for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
+          const dtPoly* poly = &tile->polys[jPoly];
+          const dtPolyRef ref = navMesh->encodePolyId(tile->salt, iTile, jPoly);
+          if (!walkFilter.passFilter(ref, tile, poly))
+            continue;
+
+          for (unsigned int iLink = poly->firstLink; iLink != DT_NULL_LINK;
+               iLink = tile->links[iLink].next) {
+            const dtPolyRef neighbourRef = tile->links[iLink].ref;
+            if (!neighbourRef)
+              continue;
+
+            const dtMeshTile* neighbourTile = 0;
+            const dtPoly* neighbourPoly = 0;
+            navMesh->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile,
+                                               &neighbourPoly);
+            if (!walkFilter.passFilter(neighbourRef, neighbourTile,
+                                       neighbourPoly))
+              continue;
+
+            // Where findPath puts the neighbour's node when it is first
+            // reached from this poly
+            vec3f mid;
+            if (dtStatusFailed(navQuery->getEdgeMidPoint(
+                    ref, poly, tile, neighbourRef, neighbourPoly,
+                    neighbourTile, mid.data())))
+              continue;
+
+            const uint32_t from = polyIndex.index(ref);
+            const uint32_t to = polyIndex.index(neighbourRef);
+            arrivals.emplace_back(to, mid);
+            adjacent.emplace_back(from, to);
+            adjacent.emplace_back(to, from);
+          }
+        }
+      }
+
+      std::sort(arrivals.begin(), arrivals.end(),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+      std::sort(adjacent.begin(), adjacent.end());
+      adjacent.erase(std::unique(adjacent.begin(), adjacent.end()),
+                     adjacent.end());
+
+      positions_.reserve(arrivals.size());
+      positionPoly_.reserve(arrivals.size());
+      for (const auto& [poly, pos] : arrivals) {
+        ++firstPosition_[poly + 1];
+        positions_.push_back(pos);
+        positionPoly_.push_back(poly);
+      }
+      neighbours_.reserve(adjacent.size());
+      for (const auto& [poly, neighbour] : adjacent) {
+        ++firstNeighbour_[poly + 1];
+        neighbours_.push_back(neighbour);
+      }
+      for (size_t i = 1; i < firstPosition_.size(); ++i) {
+        firstPosition_[i] += firstPosition_[i - 1];
+        firstNeighbour_[i] += firstNeighbour_[i - 1];
+      }
+    }
+
+    inline uint32_t numPositions(uint32_t poly) const {
+      return firstPosition_[poly + 1] - firstPosition_[poly];
+    }
+
+    // Dijkstra from all of source's positions at once
+    void costsFrom(uint32_t source, std::vector<float>& costs) const {
+      costs.assign(positions_.size(), std::numeric_limits<float>::infinity());
+
+      using Entry = std::pair<float, uint32_t>;
+      std::vector<Entry> heap;
+      for (uint32_t i = firstPosition_[source]; i < firstPosition_[source + 1];
+           ++i) {
+        costs[i] = 0;
+        heap.emplace_back(0.0f, i);
+      }
+
+      while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+        const auto [cost, from] = heap.back();
+        heap.pop_back();
+        if (cost > costs[from])
+          continue;
+
+        const uint32_t poly = positionPoly_[from];
+        for (uint32_t iNeighbour = firstNeighbour_[poly];
+             iNeighbour < firstNeighbour_[poly + 1]; ++iNeighbour) {
+          const uint32_t neighbour = neighbours_[iNeighbour];
+          for (uint32_t to = firstPosition_[neighbour];
+               to < firstPosition_[neighbour + 1]; ++to) {
+            const float toCost =
+                cost + (positions_[to] - positions_[from]).norm();
+            if (toCost < costs[to]) {
+              costs[to] = toCost;
+              heap.emplace_back(toCost, to);
+              std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+            }
+          }
+        }
+      }
+    }
+
+    void polyBounds(const std::vector<float>& costs,
+                    std::vector<Bounds>& bounds) const {
+      constexpr float inf = std::numeric_limits<float>::infinity();
+      bounds.resize(firstPosition_.size() - 1);
+      for (uint32_t iPoly = 0; iPoly < bounds.size(); ++iPoly) {
+        Bounds polyBounds{inf, -inf};
+        for (uint32_t i = firstPosition_[iPoly]; i < firstPosition_[iPoly + 1];
+             ++i) {
+          polyBounds.lo = std::min(polyBounds.lo, costs[i]);
+          polyBounds.hi = std::max(polyBounds.hi, costs[i]);
+        }
+
+        if (polyBounds.hi == inf || polyBounds.lo > polyBounds.hi)
+          polyBounds = {-inf, inf};
+        bounds[iPoly] = polyBounds;
+      }
+    }
+
+   private:
+    std::vector<uint32_t> firstPosition_;
+    std::vector<vec3f> positions_;
+    std::vector<uint32_t> positionPoly_;
+    std::vector<uint32_t> firstNeighbour_;
+    std::vector<uint32_t> neighbours_;
+  };
+
+  static inline bool reachable(const Bounds& bounds) {
+    return bounds.hi < std::numeric_limits<float>::infinity();
+  }
+
+  const PolyIndex& polyIndex_;
+  int numLandmarks_;
+  std::vector<Bounds> bounds_;
+};
+
+// findPath heuristic that takes the larger of the straight line distance and
+// the landmarks' lower bounds. Both never overestimate, so neither does the
+// larger.
+class LandmarkHeuristic {
+ public:
+  LandmarkHeuristic(const LandmarkSystem& landmarks,
+                    dtPolyRef endRef,
+                    const float* endPos)
+      : landmarks_(landmarks),
+        endBounds_(landmarks.polyBounds(endRef)),
+        endPos_(endPos) {}
+
+  inline float getCost(const dtPolyRef ref, const float* pos) const {
+    const LandmarkSystem::Bounds* bounds = landmarks_.polyBounds(ref);
+
+    float cost = dtVdist(pos, endPos_);
+    for (int i = 0; i < landmarks_.numLandmarks(); ++i) {
+      cost = std::max(cost, std::max(endBounds_[i].lo - bounds[i].hi,
+                                     bounds[i].lo - endBounds_[i].hi));
+    }
+
+    return cost * DT_FINDPATH_H_SCALE;
+  }
+
+ private:
+  const LandmarkSystem& landmarks_;
+  const LandmarkSystem::Bounds* endBounds_;
+  const float* endPos_;
+};
+
+struct NavMeshDeleter {
+  void operator()(dtNavMesh* mesh) { dtFreeNavMesh(mesh); }
+};
+
+// Navmesh state that is only written while loading. Once loaded it is never
+// modified again, so a single copy can be shared by any number of PathFinders
+// on any number of threads (see PathFinder::shareNavMesh)
+struct NavMeshData {
+  std::unique_ptr<dtNavMesh, NavMeshDeleter> navMesh = nullptr;
+  std::unique_ptr<PolyIndex> polyIndex = nullptr;
+  // References polyIndex, so must be destroyed first
+  std::unique_ptr<IslandSystem> islandSystem = nullptr;
+  // Also references polyIndex. Only navmeshes loaded from a bundle have
+  // landmarks, otherwise searches use the straight line distance.
+  std::unique_ptr<LandmarkSystem> landmarks = nullptr;
+  std::pair<vec3f, vec3f> bounds;
+};
+
+// NavMeshBundle file layout. Each navmesh's tiles are grouped in a page
+// aligned block, so the pages a loaded navmesh dirtied can be dropped when it
+// is freed, and each tile is aligned for in place use by dtNavMesh.
+const uint32_t NAVMESHBUNDLE_MAGIC =
+    'N' << 24 | 'A' << 16 | 'V' << 8 | 'B';  //'NAVB';
+const uint32_t NAVMESHBUNDLE_VERSION = 3;
+constexpr uint64_t BUNDLE_BLOCK_ALIGN = 4096;
+constexpr uint64_t BUNDLE_TILE_ALIGN = 16;
+constexpr int BUNDLE_NUM_LANDMARKS = 8;
+
+struct NavMeshBundleHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t numNavMeshes;
+  uint32_t reserved;
+  uint64_t entriesOffset;  // NavMeshBundleEntry[numNavMeshes]
+  uint64_t totalSize;
+};
+
+struct NavMeshBundleEntry {
+  uint64_t nameOffset;
+  uint64_t nameSize;
+  uint64_t blockOffset;
+  uint64_t blockSize;
+  uint64_t tilesOffset;        // NavMeshBundleTile[numTiles]
+  uint64_t polyIslandsOffset;  // uint32_t[numPolys], in PolyIndex order
+  uint64_t islandRadiiOffset;  // float[numIslands]
+  // LandmarkSystem::Bounds[numPolys * numLandmarks]
+  uint64_t landmarksOffset;
+  uint32_t numTiles;
+  uint32_t numPolys;
+  uint32_t numIslands;
+  uint32_t numLandmarks;
+  // Size and modification time of the .navmesh file when it was packed
+  uint64_t sourceSize;
+  int64_t sourceMtime;
+  float bmin[3];
+  float bmax[3];
+  dtNavMeshParams params;
+};
+
+inline bool statNavMeshFile(const std::string& path,
+                            uint64_t& size,
+                            int64_t& mtime) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return false;
+
+  size = st.st_size;
+  mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  return true;
+}
+
+struct NavMeshBundleTile {
+  uint64_t dataOffset;
+  uint64_t tileRef;
+  uint64_t dataSize;
+};
 }  // namespace impl
 
+struct NavMeshBundle::Impl {
+  ~Impl() {
+    if (base)
+      munmap(base, size);
+  }
+
+  // Tiles added to a dtNavMesh in place have their links written into the
+  // mapping, so only one navmesh per entry can use an entry's tiles at a
+  // time. Called once that navmesh has been freed.
+  void releaseInPlace(int index) const {
+    const impl::NavMeshBundleEntry& entry = entries[index];
+    // The mapping is private, so this drops the pages dtNavMesh::addTile
+    // copied on write instead of letting them pile up across loads
+    madvise(base + entry.blockOffset, entry.blockSize, MADV_DONTNEED);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    inPlace[index] = false;
+  }
+
+  unsigned char* base = nullptr;
+  size_t size = 0;
+  const impl::NavMeshBundleEntry* entries = nullptr;
+  int numNavMeshes = 0;
+  std::unordered_map<std::string, int> names;
+
+  mutable std::mutex mutex;
+  // The navmesh last loaded from each entry, shared while it is alive
+  mutable std::vector<std::weak_ptr<const impl::NavMeshData>> loaded;
+  // Whether a navmesh using each entry's tiles in place is alive
+  mutable std::vector<bool> inPlace;
+};
+
+NavMeshBundle::NavMeshBundle() : pimpl_{spimpl::make_unique_impl<Impl>()} {}
+
+NavMeshBundle::~NavMeshBundle() = default;
+
+std::shared_ptr<const NavMeshBundle> NavMeshBundle::open(
+    const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(impl::NavMeshBundleHeader)) {
+    close(fd);
+    return nullptr;
+  }
+
+  // Writable but private, dtNavMesh::addTile writes links into the tiles
+  void* base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return nullptr;
+
+  std::shared_ptr<NavMeshBundle> bundle(new NavMeshBundle());
+  Impl& b = *bundle->pimpl_;
+  b.base = static_cast<unsigned char*>(base);
+  b.size = st.st_size;
+
+  const auto inBounds = [&b](uint64_t offset, uint64_t count,
+                             uint64_t elemSize) {
+    return offset <= b.size && count <= (b.size - offset) / elemSize;
+  };
+
+  const auto& header =
+      *reinterpret_cast<const impl::NavMeshBundleHeader*>(b.base);
+  if (header.magic != impl::NAVMESHBUNDLE_MAGIC ||
+      header.version != impl::NAVMESHBUNDLE_VERSION ||
+      header.totalSize != b.size ||
+      !inBounds(header.entriesOffset, header.numNavMeshes,
+                sizeof(impl::NavMeshBundleEntry)))
+    return nullptr;
+
+  b.entries = reinterpret_cast<const impl::NavMeshBundleEntry*>(
+      b.base + header.entriesOffset);
+  b.numNavMeshes = header.numNavMeshes;
+
+  for (int i = 0; i < b.numNavMeshes; ++i) {
+    const impl::NavMeshBundleEntry& entry = b.entries[i];
+    if (!inBounds(entry.nameOffset, entry.nameSize, 1) ||
+        !inBounds(entry.blockOffset, entry.blockSize, 1) ||
+        !inBounds(entry.tilesOffset, entry.numTiles,
+                  sizeof(impl::NavMeshBundleTile)) ||
+        !inBounds(entry.polyIslandsOffset, entry.numPolys, sizeof(uint32_t)) ||
+        !inBounds(entry.islandRadiiOffset, entry.numIslands, sizeof(float)) ||
+        entry.numLandmarks > static_cast<uint32_t>(
+                                 std::numeric_limits<int>::max()) ||
+        (entry.numLandmarks > 0 &&
+         !inBounds(entry.landmarksOffset,
+                   uint64_t(entry.numPolys) * entry.numLandmarks,
+                   sizeof(impl::LandmarkSystem::Bounds))))
+      return nullptr;
+
+    const auto* tiles = reinterpret_cast<const impl::NavMeshBundleTile*>(
+        b.base + entry.tilesOffset);
+    for (uint32_t j = 0; j < entry.numTiles; ++j) {
+      if (tiles[j].dataOffset < entry.blockOffset ||
+          tiles[j].dataSize > static_cast<uint64_t>(
+                                  std::numeric_limits<int>::max()) ||
+          !inBounds(tiles[j].dataOffset, tiles[j].dataSize, 1) ||
+          tiles[j].dataOffset + tiles[j].dataSize >
+              entry.blockOffset + entry.blockSize)
+        return nullptr;
+    }
+
+    b.names.emplace(
+        std::string(reinterpret_cast<const char*>(b.base + entry.nameOffset),
+                    entry.nameSize),
+        i);
+  }
+
+  b.loaded.resize(b.numNavMeshes);
+  b.inPlace.resize(b.numNavMeshes, false);
+
+  return bundle;
+}
+
+int NavMeshBundle::find(const std::string& name) const {
+  auto it = pimpl_->names.find(name);
+  if (it == pimpl_->names.end())
+    return -1;
+
+  return it->second;
+}
+
+int NavMeshBundle::size() const {
+  return pimpl_->numNavMeshes;
+}
+
+bool NavMeshBundle::isCurrent(int index, const std::string& path) const {
+  if (index < 0 || index >= pimpl_->numNavMeshes)
+    return false;
+
+  const impl::NavMeshBundleEntry& entry = pimpl_->entries[index];
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  return impl::statNavMeshFile(path, size, mtime) &&
+         size == entry.sourceSize && mtime == entry.sourceMtime;
+}
+
+namespace {
+constexpr int CORRIDOR_MAX_POLYS = 256;
+}  // namespace
+
+struct PathCorridor::Impl {
+  Impl() { path.init(CORRIDOR_MAX_POLYS); }
+
+  dtPathCorridor path;
+  // The navmesh path's polys belong to, empty when there is no corridor.
+  // Only compared by owner, and holding the control block keeps a later
+  // navmesh from being mistaken for this one.
+  std::weak_ptr<const impl::NavMeshData> navMesh;
+};
+
+PathCorridor::PathCorridor() : pimpl_{spimpl::make_unique_impl<Impl>()} {}
+
+PathCorridor::~PathCorridor() = default;
+
+void PathCorridor::reset() {
+  pimpl_->navMesh.reset();
+}
+
 struct PathFinder::Impl {
   Impl();
   ~Impl() = default;
@@ -178,6 +833,18 @@ struct PathFinder::Impl {
 
   bool findPath(ShortestPath& path);
 
+  float geodesicDistance(const NavMeshPoint& start,
+                         const NavMeshPoint& end) const;
+
+  float geodesicDistance(PathCorridor& corridor,
+                         const NavMeshPoint& start,
+                         const NavMeshPoint& end) const;
+
+  bool buildDistanceField(const NavMeshPoint& source, DistanceField& field);
+
+  float geodesicDistance(const DistanceField& field,
+                         const NavMeshPoint& pt) const;
+
   NavMeshPoint tryStep(const NavMeshPoint& start,
                        const esp::vec3f& end,
                        bool allowSliding);
@@ -186,9 +853,20 @@ struct PathFinder::Impl {
 
   bool loadNavMesh(const std::string& path);
 
+  bool loadNavMesh(const std::shared_ptr<const NavMeshBundle>& bundle,
+                   int index);
+
+  static bool packNavMeshes(
+      const std::vector<std::pair<std::string, std::string>>& navMeshes,
+      const std::string& path);
+
   bool saveNavMesh(const std::string& path);
 
-  bool isLoaded() const { return navMesh_ != nullptr; };
+  bool shareNavMesh(const Impl& other);
+
+  void releaseNavMesh() { navMeshData_ = nullptr; }
+
+  bool isLoaded() const { return navMeshData_ != nullptr; };
 
   void seed(uint32_t newSeed);
 
@@ -196,63 +874,69 @@ struct PathFinder::Impl {
 
   bool isNavigable(const vec3f& pt, const float maxYDelta = 0.5) const;
 
-  std::pair<vec3f, vec3f> bounds() const { return bounds_; };
+  std::pair<vec3f, vec3f> bounds() const { return navMeshData_->bounds; };
 
   Eigen::Matrix<bool, Eigen::Dynamic, Eigen::Dynamic> getTopDownView(
       const float pixelsPerMeter,
       const float height);
 
  private:
-  struct NavMeshDeleter {
-    void operator()(dtNavMesh* mesh) { dtFreeNavMesh(mesh); }
-  };
-  struct NavQueryDeleter {
-    void operator()(dtNavMeshQuery* query) { dtFreeNavMeshQuery(query); }
-  };
-
-  std::unique_ptr<dtNavMesh, NavMeshDeleter> navMesh_ = nullptr;
-  std::unique_ptr<dtNavMeshQuery, NavQueryDeleter> navQuery_ = nullptr;
+  std::shared_ptr<const impl::NavMeshData> navMeshData_ = nullptr;
   std::unique_ptr<dtQueryFilter> filter_ = nullptr;
-  std::unique_ptr<impl::IslandSystem> islandSystem_ = nullptr;
 
-  std::pair<vec3f, vec3f> bounds_;
+  void removeZeroAreaPolys(dtNavMesh* navMesh);
+
+  dtNavMeshQuery* navQuery() const;
 
-  void removeZeroAreaPolys();
-  bool initNavQuery();
+  bool hasLineOfSight(const dtNavMeshQuery* navQuery,
+                      const NavMeshPoint& start,
+                      const NavMeshPoint& end) const;
+
+  dtStatus findPolyPath(const dtNavMeshQuery* navQuery,
+                        const NavMeshPoint& start,
+                        const NavMeshPoint& end,
+                        dtPolyRef* polys,
+                        int* numPolys,
+                        int maxPolys) const;
+
+  bool patchCorridor(dtNavMeshQuery* navQuery,
+                     PathCorridor::Impl& corridor,
+                     const NavMeshPoint& start,
+                     const NavMeshPoint& end) const;
 
   std::tuple<float, std::vector<vec3f>> findPathInternal(
       const NavMeshPoint& start,
       const NavMeshPoint& end);
 };
 
-namespace {
-enum PolyAreas { POLYAREA_GROUND, POLYAREA_DOOR };
-
-enum PolyFlags {
-  POLYFLAGS_WALK = 0x01,      // walkable
-  POLYFLAGS_DOOR = 0x02,      // ability to move through doors
-  POLYFLAGS_DISABLED = 0x04,  // disabled polygon
-  POLYFLAGS_ALL = 0xffff      // all abilities
-};
-}  // namespace
-
 PathFinder::Impl::Impl() {
   filter_ = std::make_unique<dtQueryFilter>();
   filter_->setIncludeFlags(POLYFLAGS_WALK);
   filter_->setExcludeFlags(0);
 }
 
-bool PathFinder::Impl::initNavQuery() {
-  navQuery_.reset(dtAllocNavMeshQuery());
-  dtStatus status = navQuery_->init(navMesh_.get(), 2048);
-  if (dtStatusFailed(status)) {
-    return false;
-  }
+namespace {
+struct NavQueryDeleter {
+  void operator()(dtNavMeshQuery* query) { dtFreeNavMeshQuery(query); }
+};
 
-  islandSystem_ =
-      std::make_unique<impl::IslandSystem>(navMesh_.get(), filter_.get());
+constexpr int MAX_QUERY_NODES = 2048;
+}  // namespace
 
-  return true;
+// A dtNavMeshQuery only holds per-query scratch space (node pools and the
+// open list), so instead of every PathFinder owning one, each thread owns a
+// single query that is re-attached to whichever navmesh is being queried.
+// Re-attaching just clears the pools, which the queries do anyway.
+dtNavMeshQuery* PathFinder::Impl::navQuery() const {
+  thread_local std::unique_ptr<dtNavMeshQuery, NavQueryDeleter> threadQuery{
+      dtAllocNavMeshQuery()};
+
+  const dtNavMesh* navMesh = navMeshData_->navMesh.get();
+  if (threadQuery->getAttachedNavMesh() != navMesh) {
+    threadQuery->init(navMesh, MAX_QUERY_NODES);
+  }
+
+  return threadQuery.get();
 }
 
 namespace {
@@ -304,24 +988,24 @@ float polyArea(const dtPoly* poly, const dtMeshTile* tile) {
 // Some polygons have zero area for some reason.  When we navigate into a zero
 // area polygon, things crash.  So we find all zero area polygons and mark
 // them as disabled/not navigable.
-void PathFinder::Impl::removeZeroAreaPolys() {
+void PathFinder::Impl::removeZeroAreaPolys(dtNavMesh* navMesh) {
   // Iterate over all tiles
-  for (int iTile = 0; iTile < navMesh_->getMaxTiles(); ++iTile) {
+  for (int iTile = 0; iTile < navMesh->getMaxTiles(); ++iTile) {
     const dtMeshTile* tile =
-        const_cast<const dtNavMesh*>(navMesh_.get())->getTile(iTile);
-    if (!tile)
+        const_cast<const dtNavMesh*>(navMesh)->getTile(iTile);
+    if (!tile || !tile->header)
       continue;
 
     // Iterate over all polygons in a tile
     for (int jPoly = 0; jPoly < tile->header->polyCount; ++jPoly) {
       // Get the polygon reference from the tile and polygon id
-      dtPolyRef polyRef = navMesh_->encodePolyId(iTile, tile->salt, jPoly);
+      dtPolyRef polyRef = navMesh->encodePolyId(tile->salt, iTile, jPoly);
       const dtPoly* poly = nullptr;
       const dtMeshTile* tmp = nullptr;
-      navMesh_->getTileAndPolyByRefUnsafe(polyRef, &tmp, &poly);
+      navMesh->getTileAndPolyByRefUnsafe(polyRef, &tmp, &poly);
 
       if (polyArea(poly, tile) < 1e-5) {
-        navMesh_->setPolyFlags(polyRef, POLYFLAGS_DISABLED);
+        navMesh->setPolyFlags(polyRef, POLYFLAGS_DISABLED);
       }
     }
   }
@@ -350,7 +1034,9 @@ bool PathFinder::Impl::loadNavMesh(const std::string& path) {
 
   vec3f bmin, bmax;
 
-  dtNavMesh* mesh = dtAllocNavMesh();
+  auto data = std::make_shared<impl::NavMeshData>();
+  data->navMesh.reset(dtAllocNavMesh());
+  dtNavMesh* mesh = data->navMesh.get();
   if (!mesh) {
     fclose(fp);
     return false;
@@ -399,18 +1085,240 @@ bool PathFinder::Impl::loadNavMesh(const std::string& path) {
 
   fclose(fp);
 
-  navMesh_.reset(mesh);
-  bounds_ = std::make_pair(bmin, bmax);
+  data->bounds = std::make_pair(bmin, bmax);
+
+  // Poly flags must be final before the islands are computed and before the
+  // navmesh is shared, after this point it is never written to again.
+  removeZeroAreaPolys(mesh);
 
-  removeZeroAreaPolys();
+  data->polyIndex = std::make_unique<impl::PolyIndex>(mesh);
+  data->islandSystem = std::make_unique<impl::IslandSystem>(
+      mesh, *data->polyIndex, filter_.get());
 
-  return initNavQuery();
+  navMeshData_ = std::move(data);
+
+  return true;
+}
+
+bool PathFinder::Impl::loadNavMesh(
+    const std::shared_ptr<const NavMeshBundle>& bundle,
+    int index) {
+  if (!bundle || index < 0 || index >= bundle->size())
+    return false;
+
+  const NavMeshBundle::Impl& b = *bundle->pimpl_;
+  const impl::NavMeshBundleEntry& entry = b.entries[index];
+
+  bool inPlace;
+  {
+    std::lock_guard<std::mutex> lock(b.mutex);
+    if (auto loaded = b.loaded[index].lock()) {
+      navMeshData_ = std::move(loaded);
+      return true;
+    }
+
+    // The last navmesh to use the tiles in place may still be being freed,
+    // in which case this one gets its own copy of the tiles
+    inPlace = !b.inPlace[index];
+    if (inPlace)
+      b.inPlace[index] = true;
+  }
+
+  std::shared_ptr<impl::NavMeshData> data;
+  if (inPlace) {
+    // Holds the bundle mapped until the navmesh stops using its tiles
+    data.reset(new impl::NavMeshData(), [bundle, index](impl::NavMeshData* d) {
+      delete d;
+      bundle->pimpl_->releaseInPlace(index);
+    });
+  } else {
+    data = std::make_shared<impl::NavMeshData>();
+  }
+
+  data->navMesh.reset(dtAllocNavMesh());
+  dtNavMesh* mesh = data->navMesh.get();
+  if (!mesh)
+    return false;
+  if (dtStatusFailed(mesh->init(&entry.params)))
+    return false;
+
+  const auto* tiles = reinterpret_cast<const impl::NavMeshBundleTile*>(
+      b.base + entry.tilesOffset);
+  for (uint32_t i = 0; i < entry.numTiles; ++i) {
+    unsigned char* tileData = b.base + tiles[i].dataOffset;
+    const int dataSize = tiles[i].dataSize;
+    int flags = 0;
+    if (!inPlace) {
+      tileData = static_cast<unsigned char*>(dtAlloc(dataSize, DT_ALLOC_PERM));
+      if (!tileData)
+        return false;
+      memcpy(tileData, b.base + tiles[i].dataOffset, dataSize);
+      flags = DT_TILE_FREE_DATA;
+    }
+
+    if (dtStatusFailed(mesh->addTile(tileData, dataSize, flags,
+                                     tiles[i].tileRef, 0))) {
+      if (!inPlace)
+        dtFree(tileData);
+      return false;
+    }
+  }
+
+  data->bounds = std::make_pair(vec3f(entry.bmin), vec3f(entry.bmax));
+
+  // Poly flags were fixed up before packing, and the islands were computed
+  // from them, so both are used as is
+  data->polyIndex = std::make_unique<impl::PolyIndex>(mesh);
+  if (data->polyIndex->numPolys() != entry.numPolys)
+    return false;
+
+  const auto* polyIslands =
+      reinterpret_cast<const uint32_t*>(b.base + entry.polyIslandsOffset);
+  const auto* islandRadii =
+      reinterpret_cast<const float*>(b.base + entry.islandRadiiOffset);
+  data->islandSystem = std::make_unique<impl::IslandSystem>(
+      *data->polyIndex,
+      std::vector<uint32_t>(polyIslands, polyIslands + entry.numPolys),
+      std::vector<float>(islandRadii, islandRadii + entry.numIslands));
+
+  if (entry.numLandmarks > 0) {
+    const auto* landmarks =
+        reinterpret_cast<const impl::LandmarkSystem::Bounds*>(
+            b.base + entry.landmarksOffset);
+    data->landmarks = std::make_unique<impl::LandmarkSystem>(
+        *data->polyIndex, entry.numLandmarks,
+        std::vector<impl::LandmarkSystem::Bounds>(
+            landmarks, landmarks + uint64_t(entry.numPolys) *
+                                       entry.numLandmarks));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(b.mutex);
+    b.loaded[index] = data;
+  }
+
+  navMeshData_ = std::move(data);
+
+  return true;
+}
+
+bool PathFinder::Impl::packNavMeshes(
+    const std::vector<std::pair<std::string, std::string>>& navMeshes,
+    const std::string& path) {
+  FILE* fp = fopen(path.c_str(), "wb");
+  if (!fp)
+    return false;
+
+  bool success = true;
+  uint64_t offset = 0;
+  const auto write = [&](const void* data, uint64_t size) {
+    if (size > 0 && fwrite(data, size, 1, fp) != 1)
+      success = false;
+    offset += size;
+  };
+  const auto align = [&](uint64_t alignment) {
+    static const unsigned char zeros[impl::BUNDLE_BLOCK_ALIGN] = {};
+    write(zeros, (alignment - offset % alignment) % alignment);
+  };
+
+  // Written again once the entries are
+  impl::NavMeshBundleHeader header{};
+  header.magic = impl::NAVMESHBUNDLE_MAGIC;
+  header.version = impl::NAVMESHBUNDLE_VERSION;
+  header.numNavMeshes = navMeshes.size();
+  write(&header, sizeof(header));
+
+  std::vector<impl::NavMeshBundleEntry> entries;
+  entries.reserve(navMeshes.size());
+  std::vector<impl::NavMeshBundleTile> tiles;
+  for (const auto& [name, navMeshPath] : navMeshes) {
+    // Loading applies the poly flag fixups and computes the islands, so
+    // both are baked into the bundle
+    Impl loaded;
+    if (!loaded.loadNavMesh(navMeshPath)) {
+      fclose(fp);
+      return false;
+    }
+    const impl::NavMeshData& data = *loaded.navMeshData_;
+    const dtNavMesh* navMesh = data.navMesh.get();
+
+    impl::NavMeshBundleEntry entry{};
+    if (!impl::statNavMeshFile(navMeshPath, entry.sourceSize,
+                               entry.sourceMtime)) {
+      fclose(fp);
+      return false;
+    }
+    memcpy(&entry.params, navMesh->getParams(), sizeof(dtNavMeshParams));
+    Eigen::Map<vec3f>(entry.bmin) = data.bounds.first;
+    Eigen::Map<vec3f>(entry.bmax) = data.bounds.second;
+
+    align(impl::BUNDLE_BLOCK_ALIGN);
+    entry.blockOffset = offset;
+    tiles.clear();
+    for (int i = 0; i < navMesh->getMaxTiles(); ++i) {
+      const dtMeshTile* tile = navMesh->getTile(i);
+      if (!tile || !tile->header || !tile->dataSize)
+        continue;
+
+      align(impl::BUNDLE_TILE_ALIGN);
+      tiles.push_back({offset, navMesh->getTileRef(tile),
+                       static_cast<uint64_t>(tile->dataSize)});
+      write(tile->data, tile->dataSize);
+    }
+    align(impl::BUNDLE_BLOCK_ALIGN);
+    entry.blockSize = offset - entry.blockOffset;
+
+    entry.numTiles = tiles.size();
+    entry.tilesOffset = offset;
+    write(tiles.data(), tiles.size() * sizeof(impl::NavMeshBundleTile));
+
+    const std::vector<uint32_t>& polyIslands =
+        data.islandSystem->polyIslands();
+    entry.numPolys = polyIslands.size();
+    entry.polyIslandsOffset = offset;
+    write(polyIslands.data(), polyIslands.size() * sizeof(uint32_t));
+
+    const std::vector<float>& islandRadii = data.islandSystem->islandRadii();
+    entry.numIslands = islandRadii.size();
+    entry.islandRadiiOffset = offset;
+    write(islandRadii.data(), islandRadii.size() * sizeof(float));
+
+    // The landmarks are too slow to select at load time, so they are only
+    // ever computed here
+    const impl::LandmarkSystem landmarks(
+        navMesh, loaded.navQuery(), *data.polyIndex, *data.islandSystem,
+        impl::BUNDLE_NUM_LANDMARKS);
+    entry.numLandmarks = landmarks.numLandmarks();
+    entry.landmarksOffset = offset;
+    write(landmarks.bounds().data(),
+          landmarks.bounds().size() * sizeof(impl::LandmarkSystem::Bounds));
+
+    entry.nameOffset = offset;
+    entry.nameSize = name.size();
+    write(name.data(), name.size());
+
+    entries.push_back(entry);
+  }
+
+  align(alignof(impl::NavMeshBundleEntry));
+  header.entriesOffset = offset;
+  write(entries.data(), entries.size() * sizeof(impl::NavMeshBundleEntry));
+  header.totalSize = offset;
+
+  if (fseek(fp, 0, SEEK_SET) != 0 ||
+      fwrite(&header, sizeof(header), 1, fp) != 1)
+    success = false;
+
+  if (fclose(fp) != 0)
+    success = false;
+
+  return success;
 }
 
 bool PathFinder::Impl::saveNavMesh(const std::string& path) {
-  const dtNavMesh* navMesh = navMesh_.get();
-  if (!navMesh)
+  if (!navMeshData_)
     return false;
+  const dtNavMesh* navMesh = navMeshData_->navMesh.get();
 
   FILE* fp = fopen(path.c_str(), "wb");
   if (!fp)
@@ -449,9 +1357,18 @@ bool PathFinder::Impl::saveNavMesh(const std::string& path) {
   return true;
 }
 
+bool PathFinder::Impl::shareNavMesh(const Impl& other) {
+  if (!other.navMeshData_)
+    return false;
+
+  navMeshData_ = other.navMeshData_;
+
+  return true;
+}
+
 void PathFinder::Impl::seed(uint32_t newSeed) {
   // TODO: this should be using core::Random instead, but passing function
-  // to navQuery_->findRandomPoint needs to be figured out first
+  // to navQuery()->findRandomPoint needs to be figured out first
   srand(newSeed);
 }
 
@@ -465,7 +1382,7 @@ vec3f PathFinder::Impl::getRandomNavigablePoint() {
   constexpr float inf = std::numeric_limits<float>::infinity();
   vec3f pt(inf, inf, inf);
 
-  navQuery_->findRandomPoint(filter_.get(), frand, &ref, pt.data());
+  navQuery()->findRandomPoint(filter_.get(), frand, &ref, pt.data());
   return pt;
 }
 
@@ -480,8 +1397,106 @@ float pathLength(const std::vector<vec3f>& points) {
 
   return length;
 }
+
+// Path query counters are kept per thread, so counting a query doesn't
+// contend with the other simulation threads. Only the owning thread writes
+// them, so increments are a plain load and store, and queryStats can still
+// read them from any thread.
+struct QueryCounters {
+  std::atomic<uint64_t> queries{0};
+  std::atomic<uint64_t> lineOfSightHits{0};
+  std::atomic<uint64_t> corridorHits{0};
+
+  QueryCounters();
+  ~QueryCounters();
+};
+
+struct QueryCounterRegistry {
+  std::mutex mutex;
+  std::vector<const QueryCounters*> live;
+  // Totals of the threads that have exited
+  PathQueryStats retired{0, 0, 0};
+};
+
+// Never destroyed, the main thread's counters can be destroyed after static
+// objects at exit and still need to retire into it
+QueryCounterRegistry& queryCounterRegistry() {
+  static QueryCounterRegistry* registry = new QueryCounterRegistry;
+  return *registry;
+}
+
+QueryCounters::QueryCounters() {
+  QueryCounterRegistry& registry = queryCounterRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.live.push_back(this);
+}
+
+QueryCounters::~QueryCounters() {
+  QueryCounterRegistry& registry = queryCounterRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.retired.queries += queries.load(std::memory_order_relaxed);
+  registry.retired.lineOfSightHits +=
+      lineOfSightHits.load(std::memory_order_relaxed);
+  registry.retired.corridorHits +=
+      corridorHits.load(std::memory_order_relaxed);
+  registry.live.erase(
+      std::find(registry.live.begin(), registry.live.end(), this));
+}
+
+QueryCounters& queryCounters() {
+  thread_local QueryCounters counters;
+  return counters;
+}
+
+inline void increment(std::atomic<uint64_t>& counter) {
+  counter.store(counter.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
 }  // namespace
 
+// Whether a ray from start reaches end's poly without leaving the navmesh.
+// If it does the straight line is the shortest path, which is what findPath
+// and findStraightPath would have found the long way.
+bool PathFinder::Impl::hasLineOfSight(const dtNavMeshQuery* navQuery,
+                                      const NavMeshPoint& start,
+                                      const NavMeshPoint& end) const {
+  static const int MAX_POLYS = 256;
+  dtPolyRef polys[MAX_POLYS];
+
+  dtRaycastHit hit;
+  hit.path = polys;
+  hit.maxPath = MAX_POLYS;
+  dtStatus status = navQuery->raycast(start.polyId, start.xyz.data(),
+                                      end.xyz.data(), filter_.get(), 0, &hit);
+
+  // The ray ending inside the last poly it visited (t == FLT_MAX) isn't
+  // enough, the ray is 2D and could be ending under or over the end on
+  // another floor
+  return status == DT_SUCCESS && hit.t == FLT_MAX && hit.pathCount > 0 &&
+         polys[hit.pathCount - 1] == end.polyId;
+}
+
+// The poly corridor between start and end, searched with the landmarks'
+// heuristic when the navmesh has landmarks
+dtStatus PathFinder::Impl::findPolyPath(const dtNavMeshQuery* navQuery,
+                                        const NavMeshPoint& start,
+                                        const NavMeshPoint& end,
+                                        dtPolyRef* polys,
+                                        int* numPolys,
+                                        int maxPolys) const {
+  if (navMeshData_->landmarks) {
+    const impl::LandmarkHeuristic heuristic(*navMeshData_->landmarks,
+                                            end.polyId, end.xyz.data());
+    return navQuery->findPath(start.polyId, end.polyId, start.xyz.data(),
+                              end.xyz.data(), &walkFilter, &heuristic, polys,
+                              numPolys, maxPolys);
+  }
+
+  return navQuery->findPath(start.polyId, end.polyId, start.xyz.data(),
+                            end.xyz.data(), &walkFilter, polys, numPolys,
+                            maxPolys);
+}
+
 std::tuple<float, std::vector<vec3f>> PathFinder::Impl::findPathInternal(
     const NavMeshPoint& start,
     const NavMeshPoint& end) {
@@ -491,18 +1506,27 @@ std::tuple<float, std::vector<vec3f>> PathFinder::Impl::findPathInternal(
   }
 
   // Check if there is a path between the start and any of the ends
-  if (!islandSystem_->hasConnection(start.polyId, end.polyId)) {
+  if (!navMeshData_->islandSystem->hasConnection(start.polyId, end.polyId)) {
     return std::make_tuple(std::numeric_limits<float>::infinity(),
                            std::vector<vec3f>{});
   }
 
+  dtNavMeshQuery* navQuery = this->navQuery();
+
+  QueryCounters& counters = queryCounters();
+  increment(counters.queries);
+  if (hasLineOfSight(navQuery, start, end)) {
+    increment(counters.lineOfSightHits);
+    return std::make_tuple((end.xyz - start.xyz).norm(),
+                           std::vector<vec3f>{start.xyz, end.xyz});
+  }
+
   static const int MAX_POLYS = 256;
   dtPolyRef polys[MAX_POLYS];
 
   int numPolys = 0;
-  dtStatus status = navQuery_->findPath(
-      start.polyId, end.polyId, start.xyz.data(), end.xyz.data(), filter_.get(),
-      polys, &numPolys, MAX_POLYS);
+  dtStatus status =
+      findPolyPath(navQuery, start, end, polys, &numPolys, MAX_POLYS);
   if (status != DT_SUCCESS || numPolys == 0) {
     return std::make_tuple(std::numeric_limits<float>::infinity(),
                            std::vector<vec3f>{});
@@ -510,7 +1534,7 @@ std::tuple<float, std::vector<vec3f>> PathFinder::Impl::findPathInternal(
 
   int numPoints = 0;
   std::vector<vec3f> points(MAX_POLYS);
-  status = navQuery_->findStraightPath(start.xyz.data(), end.xyz.data(), polys,
+  status = navQuery->findStraightPath(start.xyz.data(), end.xyz.data(), polys,
                                        numPolys, points[0].data(), 0, 0,
                                        &numPoints, MAX_POLYS);
   if (status != DT_SUCCESS || numPoints == 0) {
@@ -540,16 +1564,426 @@ bool PathFinder::Impl::findPath(ShortestPath& path) {
   return path.geodesicDistance < std::numeric_limits<float>::infinity();
 }
 
+// Same search as findPathInternal, but the corridor lives on the stack and
+// the straight path is only measured, never stored, so this doesn't touch
+// the heap.
+float PathFinder::Impl::geodesicDistance(const NavMeshPoint& start,
+                                         const NavMeshPoint& end) const {
+  if (start.xyz.isApprox(end.xyz)) {
+    return 0.0f;
+  }
+
+  if (!navMeshData_->islandSystem->hasConnection(start.polyId, end.polyId)) {
+    return std::numeric_limits<float>::infinity();
+  }
+
+  const dtNavMeshQuery* navQuery = this->navQuery();
+
+  QueryCounters& counters = queryCounters();
+  increment(counters.queries);
+  if (hasLineOfSight(navQuery, start, end)) {
+    increment(counters.lineOfSightHits);
+    return (end.xyz - start.xyz).norm();
+  }
+
+  static const int MAX_POLYS = 256;
+  dtPolyRef polys[MAX_POLYS];
+
+  int numPolys = 0;
+  dtStatus status =
+      findPolyPath(navQuery, start, end, polys, &numPolys, MAX_POLYS);
+  if (status != DT_SUCCESS || numPolys == 0) {
+    return std::numeric_limits<float>::infinity();
+  }
+
+  float length = 0.0f;
+  int numPoints = 0;
+  status = navQuery->findStraightPathLength(start.xyz.data(), end.xyz.data(),
+                                            polys, numPolys, &length,
+                                            &numPoints, MAX_POLYS);
+  if (status != DT_SUCCESS || numPoints == 0) {
+    return std::numeric_limits<float>::infinity();
+  }
+
+  return length;
+}
+
+// Moves the start of the corridor to start. As long as start is a short walk
+// from the old start, the corridor then still leads from start to end, and
+// string-pulling it gives the path without searching again.
+bool PathFinder::Impl::patchCorridor(dtNavMeshQuery* navQuery,
+                                     PathCorridor::Impl& corridor,
+                                     const NavMeshPoint& start,
+                                     const NavMeshPoint& end) const {
+  dtPathCorridor& path = corridor.path;
+  if (corridor.navMesh.owner_before(navMeshData_) ||
+      navMeshData_.owner_before(corridor.navMesh) ||
+      path.getLastPoly() != end.polyId ||
+      Eigen::Map<const vec3f>(path.getTarget()) != end.xyz) {
+    return false;
+  }
+
+  // Polys that aren't already in the corridor would have to be spliced onto
+  // its start, turning it into a detour through them rather than the
+  // shortest path
+  const dtPolyRef* polys = path.getPath();
+  if (std::find(polys, polys + path.getPathCount(), start.polyId) ==
+      polys + path.getPathCount()) {
+    return false;
+  }
+
+  if (!path.movePosition(start.xyz.data(), navQuery, filter_.get())) {
+    return false;
+  }
+
+  // The move stops short at walls and after a few polys, so it can still
+  // fail to reach start
+  return path.getFirstPoly() == start.polyId &&
+         path.getLastPoly() == end.polyId &&
+         dtVdist2DSqr(path.getPos(), start.xyz.data()) < 1e-6f;
+}
+
+// Same as the other geodesicDistance, with the search replaced by patching
+// the corridor whenever it can be
+float PathFinder::Impl::geodesicDistance(PathCorridor& corridor,
+                                         const NavMeshPoint& start,
+                                         const NavMeshPoint& end) const {
+  if (start.xyz.isApprox(end.xyz)) {
+    return 0.0f;
+  }
+
+  if (!navMeshData_->islandSystem->hasConnection(start.polyId, end.polyId)) {
+    return std::numeric_limits<float>::infinity();
+  }
+
+  dtNavMeshQuery* navQuery = this->navQuery();
+
+  QueryCounters& counters = queryCounters();
+  increment(counters.queries);
+  if (hasLineOfSight(navQuery, start, end)) {
+    increment(counters.lineOfSightHits);
+    return (end.xyz - start.xyz).norm();
+  }
+
+  PathCorridor::Impl& impl = *corridor.pimpl_;
+  dtPathCorridor& path = impl.path;
+  if (patchCorridor(navQuery, impl, start, end)) {
+    increment(counters.corridorHits);
+  } else {
+    dtPolyRef polys[CORRIDOR_MAX_POLYS];
+
+    int numPolys = 0;
+    dtStatus status = findPolyPath(navQuery, start, end, polys, &numPolys,
+                                   CORRIDOR_MAX_POLYS);
+    if (status != DT_SUCCESS || numPolys == 0) {
+      impl.navMesh.reset();
+      return std::numeric_limits<float>::infinity();
+    }
+
+    path.reset(start.polyId, start.xyz.data());
+    path.setCorridor(end.xyz.data(), polys, numPolys);
+    impl.navMesh = navMeshData_;
+  }
+
+  float length = 0.0f;
+  int numPoints = 0;
+  dtStatus status = navQuery->findStraightPathLength(
+      start.xyz.data(), end.xyz.data(), path.getPath(), path.getPathCount(),
+      &length, &numPoints, CORRIDOR_MAX_POLYS);
+  if (status != DT_SUCCESS || numPoints == 0) {
+    return std::numeric_limits<float>::infinity();
+  }
+
+  return length;
+}
+
+namespace {
+// The two endpoints of the edge that link leads out of poly through, clamped
+// to the part of the edge that is actually shared when the link crosses a
+// tile boundary (same as dtNavMeshQuery::getPortalPoints)
+void portalPoints(const dtMeshTile* tile,
+                  const dtPoly* poly,
+                  const dtLink& link,
+                  vec3f& left,
+                  vec3f& right) {
+  left = Eigen::Map<const vec3f>(&tile->verts[poly->verts[link.edge] * 3]);
+  right = Eigen::Map<const vec3f>(
+      &tile->verts[poly->verts[(link.edge + 1) % poly->vertCount] * 3]);
+
+  if (link.side != 0xff && (link.bmin != 0 || link.bmax != 255)) {
+    const float tmin = link.bmin / 255.f;
+    const float tmax = link.bmax / 255.f;
+    const vec3f edge = right - left;
+    right = left + edge * tmax;
+    left = left + edge * tmin;
+  }
+}
+
+vec3f polyCentroid(const dtMeshTile* tile, const dtPoly* poly) {
+  vec3f centroid = vec3f::Zero();
+  for (int iVert = 0; iVert < poly->vertCount; ++iVert) {
+    centroid += Eigen::Map<const vec3f>(&tile->verts[poly->verts[iVert] * 3]);
+  }
+
+  return centroid / poly->vertCount;
+}
+
+// Twice the signed area of the triangle a, b, c in the xz-plane, with the
+// same sign as dtTriArea2D
+float triArea2D(const vec3f& a, const vec3f& b, const vec3f& c) {
+  const float abx = b[0] - a[0], abz = b[2] - a[2];
+  const float acx = c[0] - a[0], acz = c[2] - a[2];
+  return acx * abz - abx * acz;
+}
+
+// The funnel of paths from a poly to the field's source, as stored in a
+// DistanceField::Poly. Left and right are as seen looking away from the
+// apex, the same as the portals of dtNavMeshQuery::findStraightPath, and
+// each side turns in towards the other at every corner.
+struct Funnel {
+  vec3f apex;
+  float apexDistance;
+  const DistanceField::Point* left;
+  int numLeft;
+  const DistanceField::Point* right;
+  int numRight;
+
+  Funnel(const DistanceField& field, const DistanceField::Poly& entry)
+      : apex(entry.apex),
+        apexDistance(entry.apexDistance),
+        left(field.points.data() + entry.firstPoint),
+        numLeft(entry.numLeft),
+        right(left + entry.numLeft),
+        numRight(entry.numRight) {}
+
+  Funnel(const vec3f& apex_,
+         float apexDistance_,
+         const DistanceField::Point* points,
+         int numLeft_,
+         int numRight_)
+      : apex(apex_),
+        apexDistance(apexDistance_),
+        left(points),
+        numLeft(numLeft_),
+        right(points + numLeft_),
+        numRight(numRight_) {}
+
+  // The path from pt, which must be past the funnel's portal, first bends
+  // around some number of corners of one side and then goes straight to the
+  // apex. Returns that side's corners, and how many of them the path goes
+  // around, counting from the apex. There are none when pt can see the apex
+  // through the whole funnel. Points in line with a side go around its
+  // corner, as findStraightPath moves its apex on for them: where storeys
+  // overlap, the line can be the edge of a floor above a ramp.
+  std::pair<const DistanceField::Point*, int> corners(const vec3f& pt) const {
+    if (numLeft > 0 && triArea2D(apex, left[0].xyz, pt) <= 0.0f) {
+      int n = 1;
+      while (n < numLeft &&
+             triArea2D(left[n - 1].xyz, left[n].xyz, pt) <= 0.0f)
+        ++n;
+      return {left, n};
+    }
+
+    if (numRight > 0 && triArea2D(apex, right[0].xyz, pt) >= 0.0f) {
+      int n = 1;
+      while (n < numRight &&
+             triArea2D(right[n - 1].xyz, right[n].xyz, pt) >= 0.0f)
+        ++n;
+      return {right, n};
+    }
+
+    return {left, 0};
+  }
+
+  float distance(const vec3f& pt) const {
+    const std::pair<const DistanceField::Point*, int> path = corners(pt);
+    if (path.second == 0)
+      return (pt - apex).norm() + apexDistance;
+
+    const DistanceField::Point& corner = path.first[path.second - 1];
+    return (pt - corner.xyz).norm() + corner.distance;
+  }
+};
+}  // namespace
+
+// Dijkstra over the poly graph, outwards from the source poly. Every poly
+// keeps the whole funnel of paths through the chain of polys it was reached
+// by, which gives the distance from any point inside it exactly, the same
+// as string pulling that chain would. A neighbour's funnel is the parent's,
+// narrowed down to the portal between them: the shortest paths to the
+// portal's two corners share everything up to the new apex and split into
+// the new funnel's two sides after it. Polys are ordered by the distance of
+// their centroid.
+bool PathFinder::Impl::buildDistanceField(const NavMeshPoint& source,
+                                          DistanceField& field) {
+  constexpr float inf = std::numeric_limits<float>::infinity();
+  const dtNavMesh* navMesh = navMeshData_->navMesh.get();
+  const impl::PolyIndex& polyIndex = *navMeshData_->polyIndex;
+  const uint32_t numPolys = polyIndex.numPolys();
+
+  field.source = source;
+  field.polys.assign(numPolys, {vec3f::Zero(), inf, 0, 0, 0});
+  field.points.clear();
+
+  if (!navMesh->isValidPolyRef(source.polyId))
+    return false;
+
+  // Scratch space is reused across calls so that steady state resets don't
+  // allocate
+  thread_local std::vector<float> bestKey;
+  thread_local std::vector<uint8_t> settled;
+  thread_local std::vector<std::pair<float, dtPolyRef>> heap;
+  thread_local std::vector<DistanceField::Point> parentPoints;
+  thread_local std::vector<DistanceField::Point> candidatePoints;
+  bestKey.assign(numPolys, inf);
+  settled.assign(numPolys, 0);
+  heap.clear();
+
+  const auto heapCmp = [](const std::pair<float, dtPolyRef>& a,
+                          const std::pair<float, dtPolyRef>& b) {
+    return a.first > b.first;
+  };
+
+  const uint32_t sourceIdx = polyIndex.index(source.polyId);
+  field.polys[sourceIdx] = {source.xyz, 0.0f, 0, 0, 0};
+  bestKey[sourceIdx] = 0.0f;
+  heap.emplace_back(0.0f, source.polyId);
+
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), heapCmp);
+    const dtPolyRef ref = heap.back().second;
+    heap.pop_back();
+
+    const uint32_t idx = polyIndex.index(ref);
+    if (settled[idx])
+      continue;
+    settled[idx] = 1;
+
+    const dtMeshTile* tile = nullptr;
+    const dtPoly* poly = nullptr;
+    navMesh->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+
+    // Candidate funnels are appended to field.points, so work from a copy
+    const DistanceField::Poly& entry = field.polys[idx];
+    parentPoints.assign(
+        field.points.begin() + entry.firstPoint,
+        field.points.begin() + entry.firstPoint + entry.numLeft +
+            entry.numRight);
+    const Funnel parent(entry.apex, entry.apexDistance, parentPoints.data(),
+                        entry.numLeft, entry.numRight);
+
+    for (unsigned int iLink = poly->firstLink; iLink != DT_NULL_LINK;
+         iLink = tile->links[iLink].next) {
+      const dtLink& link = tile->links[iLink];
+      const dtPolyRef neighbourRef = link.ref;
+      if (!neighbourRef)
+        continue;
+
+      const uint32_t neighbourIdx = polyIndex.index(neighbourRef);
+      if (settled[neighbourIdx])
+        continue;
+
+      const dtMeshTile* neighbourTile = nullptr;
+      const dtPoly* neighbourPoly = nullptr;
+      navMesh->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile,
+                                         &neighbourPoly);
+      if (neighbourPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION ||
+          !walkFilter.passFilter(neighbourRef, neighbourTile, neighbourPoly))
+        continue;
+
+      vec3f portal[2];
+      portalPoints(tile, poly, link, portal[0], portal[1]);
+
+      // The corners the paths to each end of the portal go around. They
+      // share the corners both go around, if they leave on the same side.
+      std::pair<const DistanceField::Point*, int> paths[2] = {
+          parent.corners(portal[0]), parent.corners(portal[1])};
+      int numShared = 0;
+      if (paths[0].first == paths[1].first)
+        numShared = std::min(paths[0].second, paths[1].second);
+
+      vec3f apex = parent.apex;
+      float apexDistance = parent.apexDistance;
+      if (numShared > 0) {
+        apex = paths[0].first[numShared - 1].xyz;
+        apexDistance = paths[0].first[numShared - 1].distance;
+      }
+
+      candidatePoints.clear();
+      int numSide[2];
+      for (int iSide = 0; iSide < 2; ++iSide) {
+        const DistanceField::Point* path = paths[iSide].first;
+        candidatePoints.insert(candidatePoints.end(), path + numShared,
+                               path + paths[iSide].second);
+
+        const vec3f* last = &apex;
+        float lastDistance = apexDistance;
+        if (paths[iSide].second > numShared) {
+          last = &candidatePoints.back().xyz;
+          lastDistance = candidatePoints.back().distance;
+        }
+        candidatePoints.push_back(
+            {portal[iSide], (portal[iSide] - *last).norm() + lastDistance});
+        numSide[iSide] = paths[iSide].second - numShared + 1;
+      }
+
+      const Funnel candidate(apex, apexDistance, candidatePoints.data(),
+                             numSide[0], numSide[1]);
+      const float key =
+          candidate.distance(polyCentroid(neighbourTile, neighbourPoly));
+
+      if (key < bestKey[neighbourIdx]) {
+        bestKey[neighbourIdx] = key;
+        field.polys[neighbourIdx] = {
+            apex, apexDistance, static_cast<uint32_t>(field.points.size()),
+            static_cast<uint16_t>(numSide[0]),
+            static_cast<uint16_t>(numSide[1])};
+        field.points.insert(field.points.end(), candidatePoints.begin(),
+                            candidatePoints.end());
+        heap.emplace_back(key, neighbourRef);
+        std::push_heap(heap.begin(), heap.end(), heapCmp);
+      }
+    }
+  }
+
+  return true;
+}
+
+float PathFinder::Impl::geodesicDistance(const DistanceField& field,
+                                         const NavMeshPoint& pt) const {
+  constexpr float inf = std::numeric_limits<float>::infinity();
+  const dtNavMesh* navMesh = navMeshData_->navMesh.get();
+
+  // The source poly is convex, so everything in it can see the source
+  if (pt.polyId == field.source.polyId)
+    return (pt.xyz - field.source.xyz).norm();
+
+  if (!navMesh->isValidPolyRef(pt.polyId))
+    return inf;
+
+  const uint32_t idx = navMeshData_->polyIndex->index(pt.polyId);
+  if (idx >= field.polys.size())
+    return inf;
+
+  const DistanceField::Poly& entry = field.polys[idx];
+  if (entry.apexDistance == inf)
+    return inf;
+
+  return Funnel(field, entry).distance(pt.xyz);
+}
+
 NavMeshPoint PathFinder::Impl::tryStep(const NavMeshPoint& start,
                                        const esp::vec3f& endXYZ,
                                        bool allowSliding) {
   static const int MAX_POLYS = 256;
   dtPolyRef polys[MAX_POLYS];
 
+  dtNavMeshQuery* navQuery = this->navQuery();
+
   vec3f endPoint;
   int numPolys;
-  navQuery_->moveAlongSurface(start.polyId, start.xyz.data(), endXYZ.data(),
-                              filter_.get(), endPoint.data(), polys, &numPolys,
+  navQuery->moveAlongSurface(start.polyId, start.xyz.data(), endXYZ.data(),
+                              &walkFilter, endPoint.data(), polys, &numPolys,
                               MAX_POLYS, allowSliding);
   // If there isn't any possible path between start and end, just return
   // start, that is cleanest
@@ -565,7 +1999,7 @@ NavMeshPoint PathFinder::Impl::tryStep(const NavMeshPoint& start,
   // surface at the endPoint and set its height to that.
   // Note, this will never fail as endPoint is always within in the poly
   // polys[numPolys - 1]
-  navQuery_->getPolyHeight(polys[numPolys - 1], endPoint.data(), &endPoint[1]);
+  navQuery->getPolyHeight(polys[numPolys - 1], endPoint.data(), &endPoint[1]);
 
   return {endPoint, polys[numPolys - 1]};
 }
@@ -574,7 +2008,7 @@ NavMeshPoint PathFinder::Impl::snapPoint(const esp::vec3f& pt) {
   dtStatus status;
   NavMeshPoint navPt;
   std::tie(status, navPt.polyId, navPt.xyz) =
-      projectToPoly(pt, navQuery_.get(), filter_.get());
+      projectToPoly(pt, navQuery(), &walkFilter);
 
   if (dtStatusSucceed(status)) {
     return navPt;
@@ -587,11 +2021,11 @@ float PathFinder::Impl::islandRadius(const vec3f& pt) const {
   dtPolyRef ptRef;
   dtStatus status;
   std::tie(status, ptRef, std::ignore) =
-      projectToPoly(pt, navQuery_.get(), filter_.get());
+      projectToPoly(pt, navQuery(), &walkFilter);
   if (status != DT_SUCCESS || ptRef == 0) {
     return 0.0;
   } else {
-    return islandSystem_->islandRadius(ptRef);
+    return navMeshData_->islandSystem->islandRadius(ptRef);
   }
 }
 
@@ -601,7 +2035,7 @@ bool PathFinder::Impl::isNavigable(const vec3f& pt,
   dtStatus status;
   vec3f polyPt;
   std::tie(status, ptRef, polyPt) =
-      projectToPoly(pt, navQuery_.get(), filter_.get());
+      projectToPoly(pt, navQuery(), &walkFilter);
 
   if (status != DT_SUCCESS || ptRef == 0)
     return false;
@@ -656,6 +2090,43 @@ bool PathFinder::findPath(ShortestPath& path) {
   return pimpl_->findPath(path);
 }
 
+float PathFinder::geodesicDistance(const NavMeshPoint& start,
+                                   const NavMeshPoint& end) const {
+  return pimpl_->geodesicDistance(start, end);
+}
+
+float PathFinder::geodesicDistance(PathCorridor& corridor,
+                                   const NavMeshPoint& start,
+                                   const NavMeshPoint& end) const {
+  return pimpl_->geodesicDistance(corridor, start, end);
+}
+
+PathQueryStats PathFinder::queryStats() {
+  QueryCounterRegistry& registry = queryCounterRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  PathQueryStats stats = registry.retired;
+  for (const QueryCounters* counters : registry.live) {
+    stats.queries += counters->queries.load(std::memory_order_relaxed);
+    stats.lineOfSightHits +=
+        counters->lineOfSightHits.load(std::memory_order_relaxed);
+    stats.corridorHits +=
+        counters->corridorHits.load(std::memory_order_relaxed);
+  }
+
+  return stats;
+}
+
+bool PathFinder::buildDistanceField(const NavMeshPoint& source,
+                                    DistanceField& field) {
+  return pimpl_->buildDistanceField(source, field);
+}
+
+float PathFinder::geodesicDistance(const DistanceField& field,
+                                   const NavMeshPoint& pt) const {
+  return pimpl_->geodesicDistance(field, pt);
+}
+
 NavMeshPoint PathFinder::tryStep(const NavMeshPoint& start,
                                  const esp::vec3f& end) {
   return pimpl_->tryStep(start, end, /*allowSliding=*/true);
@@ -674,10 +2145,30 @@ bool PathFinder::loadNavMesh(const std::string& path) {
   return pimpl_->loadNavMesh(path);
 }
 
+bool PathFinder::loadNavMesh(
+    const std::shared_ptr<const NavMeshBundle>& bundle,
+    int index) {
+  return pimpl_->loadNavMesh(bundle, index);
+}
+
+bool PathFinder::packNavMeshes(
+    const std::vector<std::pair<std::string, std::string>>& navMeshes,
+    const std::string& path) {
+  return Impl::packNavMeshes(navMeshes, path);
+}
+
 bool PathFinder::saveNavMesh(const std::string& path) {
   return pimpl_->saveNavMesh(path);
 }
 
+bool PathFinder::shareNavMesh(const PathFinder& other) {
+  return pimpl_->shareNavMesh(*other.pimpl_);
+}
+
+void PathFinder::releaseNavMesh() {
+  pimpl_->releaseNavMesh();
+}
+
 bool PathFinder::isLoaded() const {
   return pimpl_->isLoaded();
 }
@@ -92,6 +92,187 @@ struct ShortestPath {
   ESP_SMART_POINTERS(ShortestPath)
 };
 
+/**
+ * @brief Single-source geodesic distance field over the navigation mesh.
+ * Built by @ref PathFinder.buildDistanceField and queried with @ref
+ * PathFinder.geodesicDistance
+ *
+ * Once built, the distance from any point on the navigation mesh to @ref
+ * source is a lookup plus a few flops, instead of an A* search. Distances
+ * are those of the shortest path through the chain of polygons the field
+ * reached each polygon by, the same string pulled length findPath gives for
+ * that corridor. They are never shorter than the geodesic distance, and
+ * equal to it wherever a single chain of polygons joins the two points.
+ * Elsewhere the chain is picked by the distances of polygon centroids, and
+ * like findPath's can be a little longer than the geodesic.
+ */
+struct DistanceField {
+  /**
+   * @brief A corner paths can bend around on the way to the source
+   */
+  struct Point {
+    vec3f xyz;
+
+    /**
+     * @brief The geodesic distance from @ref xyz to the source
+     */
+    float distance;
+  };
+
+  /**
+   * @brief Per polygon field data, the funnel of paths from the polygon to
+   * the source. Paths from points in the polygon that can see @ref apex
+   * through every portal on the way go straight to it, the others bend
+   * around the corners of the funnel's left or right side first.
+   */
+  struct Poly {
+    /**
+     * @brief Where the funnel's two sides meet
+     */
+    vec3f apex;
+
+    /**
+     * @brief The geodesic distance from @ref apex to the source
+     *
+     * @note Will be inf if the polygon can't reach the source
+     */
+    float apexDistance;
+
+    /**
+     * @brief Index in @ref DistanceField.points of the left side's corners,
+     * followed by the right side's. Each side runs outwards from the apex
+     * and ends at the corner of the portal into this polygon.
+     */
+    uint32_t firstPoint;
+    uint16_t numLeft;
+    uint16_t numRight;
+  };
+
+  /**
+   * @brief The point distances are measured to
+   */
+  NavMeshPoint source;
+
+  /**
+   * @brief Field data for every polygon in the navigation mesh, only
+   * meaningful to the PathFinder that built it
+   */
+  std::vector<Poly> polys;
+
+  /**
+   * @brief The funnel sides of all polygons
+   */
+  std::vector<Point> points;
+
+  ESP_SMART_POINTERS(DistanceField)
+};
+
+/**
+ * @brief Counts of the path searches done by @ref PathFinder.findPath and
+ * @ref PathFinder.geodesicDistance, see @ref PathFinder.queryStats
+ */
+struct PathQueryStats {
+  /**
+   * @brief Queries between two connected points, which need either a search
+   * or the line of sight shortcut
+   */
+  uint64_t queries;
+
+  /**
+   * @brief Queries answered by the line of sight shortcut, without a search
+   */
+  uint64_t lineOfSightHits;
+
+  /**
+   * @brief Queries answered by patching a @ref PathCorridor, without a
+   * search
+   */
+  uint64_t corridorHits;
+};
+
+/**
+ * @brief The poly corridor from a moving point to a fixed goal, kept between
+ * calls to @ref PathFinder.geodesicDistance
+ *
+ * While the point moves in small steps along the corridor, each query just
+ * trims the start of the corridor up to it and string-pulls the rest, so the
+ * path search only runs again once the point leaves the corridor or the goal
+ * changes.
+ *
+ * Only meaningful to the navigation mesh it was last queried on. Querying
+ * with a different navigation mesh or goal replaces the corridor.
+ */
+class PathCorridor {
+ public:
+  PathCorridor();
+  ~PathCorridor();
+
+  /**
+   * @brief Drops the corridor, so the next query searches from scratch
+   */
+  void reset();
+
+ private:
+  friend class PathFinder;
+
+  ESP_UNIQUE_PTR_PIMPL()
+};
+
+/**
+ * @brief A read-only file packing many navigation meshes together, written by
+ * @ref PathFinder.packNavMeshes and loaded with @ref PathFinder.loadNavMesh
+ *
+ * The bundle is memory mapped, and navigation meshes loaded from it use its
+ * tiles in place. Poly flags, islands and bounds are baked in when packing, so
+ * loading a navigation mesh only costs the page faults on its tiles.
+ *
+ * Packing also stores landmark tables for each navigation mesh, which give
+ * path searches on it a much tighter A* heuristic than the straight line
+ * distance.
+ */
+class NavMeshBundle {
+ public:
+  ~NavMeshBundle();
+
+  /**
+   * @brief Maps a bundle written by @ref PathFinder.packNavMeshes
+   *
+   * @return The bundle, nullptr if it couldn't be mapped or is malformed
+   */
+  static std::shared_ptr<const NavMeshBundle> open(const std::string& path);
+
+  /**
+   * @brief Looks up a navigation mesh by the name it was packed under
+   *
+   * @return The navigation mesh's index in the bundle, -1 if there is none
+   */
+  int find(const std::string& name) const;
+
+  /**
+   * @return The number of navigation meshes in the bundle
+   */
+  int size() const;
+
+  /**
+   * @brief Checks a navigation mesh against the file it was packed from,
+   * which may have been rebuilt or replaced since
+   *
+   * @param[in] index The navigation mesh's index, see @ref find
+   * @param[in] path The navigation mesh's ``.navmesh`` file
+   *
+   * @return Whether the file still has the size and modification time it
+   * had when the bundle was packed
+   */
+  bool isCurrent(int index, const std::string& path) const;
+
+ private:
+  NavMeshBundle();
+
+  friend class PathFinder;
+
+  ESP_UNIQUE_PTR_PIMPL()
+};
+
 /** Loads and/or builds a navigation mesh and then performs path
  * finding and collision queries on that navmesh
  *
@@ -127,6 +308,70 @@ class PathFinder {
    */
   bool findPath(ShortestPath& path);
 
+  /**
+   * @brief Computes the geodesic distance between two points on the
+   * navigation mesh
+   *
+   * Gives the same distance as @ref findPath, without building the path.
+   * Uses only stack and per-thread query storage, so it never allocates.
+   *
+   * @return The geodesic distance, inf if no path exists
+   */
+  float geodesicDistance(const NavMeshPoint& start,
+                         const NavMeshPoint& end) const;
+
+  /**
+   * @brief Computes the geodesic distance between two points on the
+   * navigation mesh, reusing the path @ref corridor holds from an earlier
+   * query toward the same @ref end
+   *
+   * Gives the distance along the corridor after moving its start to @ref
+   * start, which is usually the distance @ref findPath gives. Where several
+   * corridors are nearly as short, the two may settle on different ones, so
+   * the distances can differ slightly either way.
+   *
+   * @param[inout] corridor The corridor to patch, replaced by a new search
+   * when @ref start isn't in one of its polygons or it leads somewhere other
+   * than @ref end
+   *
+   * @return The geodesic distance, inf if no path exists
+   */
+  float geodesicDistance(PathCorridor& corridor,
+                         const NavMeshPoint& start,
+                         const NavMeshPoint& end) const;
+
+  /**
+   * @brief Totals of the queries done by @ref findPath and @ref
+   * geodesicDistance, over all PathFinders on all threads
+   *
+   * All of them first cast a ray from start to end, and when it reaches the
+   * end unobstructed the straight line is the path, so no search is needed.
+   * These counters show how often that happens, and how often a @ref
+   * PathCorridor saves the search instead.
+   */
+  static PathQueryStats queryStats();
+
+  /**
+   * @brief Computes the geodesic distance from every point on the navigation
+   * mesh to @ref source, see @ref DistanceField
+   *
+   * @param[in] source The point distances will be measured to
+   * @param[out] field The field to fill. Its storage is reused, so
+   * rebuilding a field for the same navigation mesh doesn't allocate
+   *
+   * @return Whether or not @ref source is on the navigation mesh
+   */
+  bool buildDistanceField(const NavMeshPoint& source, DistanceField& field);
+
+  /**
+   * @brief Looks up the geodesic distance between @ref pt and the source of
+   * a field built by @ref buildDistanceField
+   *
+   * @return The geodesic distance, inf if no path exists
+   */
+  float geodesicDistance(const DistanceField& field,
+                         const NavMeshPoint& pt) const;
+
   /**
    * @brief Attempts to move from @ref start to @ref end and returns the
    * navigable point closest to @ref end that is feasibly reachable from @ref
@@ -165,6 +410,39 @@ class PathFinder {
    */
   bool loadNavMesh(const std::string& path);
 
+  /**
+   * @brief Loads a navigation mesh from a bundle written by @ref
+   * packNavMeshes
+   *
+   * The navigation mesh's tiles are used straight from the bundle's mapping.
+   * While a navigation mesh from the bundle is loaded, loading the same index
+   * again shares it instead of loading a copy.
+   *
+   * @param[in] bundle The bundle, kept mapped until the navigation mesh is
+   * released
+   * @param[in] index The navigation mesh's index, see @ref
+   * NavMeshBundle.find
+   *
+   * @return Whether or not the navmesh was successfully loaded
+   */
+  bool loadNavMesh(const std::shared_ptr<const NavMeshBundle>& bundle,
+                   int index);
+
+  /**
+   * @brief Packs navigation meshes saved by @ref saveNavMesh into a single
+   * bundle, see @ref NavMeshBundle
+   *
+   * @param[in] navMeshes The name each navigation mesh is packed under,
+   * paired with the path of its ``.navmesh`` file
+   * @param[in] path The name of the bundle file
+   *
+   * @return Whether or not every navigation mesh was loaded and the bundle
+   * was successfully saved
+   */
+  static bool packNavMeshes(
+      const std::vector<std::pair<std::string, std::string>>& navMeshes,
+      const std::string& path);
+
   /**
    * @brief Saves a navigation mesh to later be loaded by @ref loadNavMesh
    *
@@ -175,6 +453,27 @@ class PathFinder {
    */
   bool saveNavMesh(const std::string& path);
 
+  /**
+   * @brief Makes this PathFinder use the navigation mesh already loaded by
+   * @ref other instead of loading a copy of its own
+   *
+   * The navigation mesh and its island data are immutable once loaded, so
+   * they are shared rather than copied. Query scratch space is allocated once
+   * per thread, not per PathFinder, so this is cheap enough to give every
+   * thread its own PathFinder for every scene.
+   *
+   * @param[in] other A PathFinder with a loaded navigation mesh
+   *
+   * @return Whether or not @ref other had a navigation mesh to share
+   */
+  bool shareNavMesh(const PathFinder& other);
+
+  /**
+   * @brief Drops this PathFinder's reference to its navigation mesh. The
+   * navigation mesh is freed once no PathFinder shares it any more
+   */
+  void releaseNavMesh();
+
   /**
    * @return If a navigation mesh is current loaded or not
    */
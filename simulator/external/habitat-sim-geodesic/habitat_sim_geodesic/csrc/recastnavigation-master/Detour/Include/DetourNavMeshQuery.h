@@ -20,6 +20,7 @@
 #define DETOURNAVMESHQUERY_H
 
 #include "DetourNavMesh.h"
+#include "DetourNode.h"
 #include "DetourStatus.h"
 
 
@@ -192,6 +193,26 @@ public:
 					  const dtQueryFilter* filter,
 					  dtPolyRef* path, int* pathCount, const int maxPath) const;
 
+	/// Finds a path from the start polygon to the end polygon, with the filter
+	/// type known at compile time so passFilter() and getCost() can be inlined.
+	/// @see findPath, dtIncludeFlagsFilter
+	template <class Filter>
+	dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const Filter* filter,
+					  dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// Finds a path from the start polygon to the end polygon, using
+	/// @p heur as the A* estimate of the remaining path cost instead of
+	/// the straight line distance to @p endPos. The path is only the shortest
+	/// one if the heuristic never overestimates.
+	/// @see findPath, dtDistanceHeuristic
+	template <class Filter, class Heuristic>
+	dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const Filter* filter, const Heuristic* heur,
+					  dtPolyRef* path, int* pathCount, const int maxPath) const;
+
 	/// Finds the straight path from the start to the end position within the polygon corridor.
 	///  @param[in]		startPos			Path start position. [(x, y, z)]
 	///  @param[in]		endPos				Path end position. [(x, y, z)]
@@ -209,6 +230,20 @@ public:
 							  float* straightPath, unsigned char* straightPathFlags, dtPolyRef* straightPathRefs,
 							  int* straightPathCount, const int maxStraightPath, const int options = 0) const;
 
+	/// Finds the length of the straight path from the start to the end position within the polygon corridor,
+	/// without storing the path points.
+	///  @param[in]		startPos			Path start position. [(x, y, z)]
+	///  @param[in]		endPos				Path end position. [(x, y, z)]
+	///  @param[in]		path				An array of polygon references that represent the path corridor.
+	///  @param[in]		pathSize			The number of polygons in the @p path array.
+	///  @param[out]	pathLength			The length of the straight path.
+	///  @param[out]	straightPathCount	The number of points findStraightPath would return.
+	///  @param[in]		maxStraightPath		The maximum number of points findStraightPath could return.  [Limit: > 0]
+	/// @returns The status flags for the query, matching those of findStraightPath with no options.
+	dtStatus findStraightPathLength(const float* startPos, const float* endPos,
+									const dtPolyRef* path, const int pathSize,
+									float* pathLength, int* straightPathCount, const int maxStraightPath) const;
+
 	///@}
 	/// @name Sliced Pathfinding Functions
 	/// Common use case:
@@ -323,6 +358,14 @@ public:
 							 const dtQueryFilter* filter,
 							 dtPolyRef* nearestRef, float* nearestPt) const;
 
+	/// Finds the polygon nearest to the specified center point using a filter
+	/// type known at compile time.
+	/// @see findNearestPoly, dtIncludeFlagsFilter
+	template <class Filter>
+	dtStatus findNearestPoly(const float* center, const float* halfExtents,
+							 const Filter* filter,
+							 dtPolyRef* nearestRef, float* nearestPt) const;
+
 	/// Finds polygons that overlap the search box.
 	///  @param[in]		center		The center of the search box. [(x, y, z)]
 	///  @param[in]		halfExtents		The search distance along each axis. [(x, y, z)]
@@ -343,6 +386,13 @@ public:
 	dtStatus queryPolygons(const float* center, const float* halfExtents,
 						   const dtQueryFilter* filter, dtPolyQuery* query) const;
 
+	/// Finds polygons that overlap the search box using a filter type known at
+	/// compile time.
+	/// @see queryPolygons, dtIncludeFlagsFilter
+	template <class Filter>
+	dtStatus queryPolygons(const float* center, const float* halfExtents,
+						   const Filter* filter, dtPolyQuery* query) const;
+
 	/// Finds the non-overlapping navigation polygons in the local neighbourhood around the center position.
 	///  @param[in]		startRef		The reference id of the polygon where the search starts.
 	///  @param[in]		centerPos		The center of the query circle. [(x, y, z)]
@@ -373,6 +423,14 @@ public:
 							  const dtQueryFilter* filter,
 							  float* resultPos, dtPolyRef* visited, int* visitedCount, const int maxVisitedSize, bool allowSliding) const;
 
+	/// Moves from the start to the end position constrained to the navigation
+	/// mesh, using a filter type known at compile time.
+	/// @see moveAlongSurface, dtIncludeFlagsFilter
+	template <class Filter>
+	dtStatus moveAlongSurface(dtPolyRef startRef, const float* startPos, const float* endPos,
+							  const Filter* filter,
+							  float* resultPos, dtPolyRef* visited, int* visitedCount, const int maxVisitedSize, bool allowSliding) const;
+
 	/// Casts a 'walkability' ray along the surface of the navigation mesh from
 	/// the start position toward the end position.
 	/// @note A wrapper around raycast(..., RaycastHit*). Retained for backward compatibility.
@@ -497,12 +555,19 @@ public:
 
 	/// Gets the node pool.
 	/// @returns The node pool.
-	class dtNodePool* getNodePool() const { return m_nodePool; }
+	dtQueryNodePool* getNodePool() const { return m_nodePool; }
 
 	/// Gets the navigation mesh the query object is using.
 	/// @return The navigation mesh the query object is using.
 	const dtNavMesh* getAttachedNavMesh() const { return m_nav; }
 
+	/// Returns edge mid point between two polygons, which is where findPath
+	/// places the search node of polygon @p to when reached from @p from.
+	dtStatus getEdgeMidPoint(dtPolyRef from, dtPolyRef to, float* mid) const;
+	dtStatus getEdgeMidPoint(dtPolyRef from, const dtPoly* fromPoly, const dtMeshTile* fromTile,
+							 dtPolyRef to, const dtPoly* toPoly, const dtMeshTile* toTile,
+							 float* mid) const;
+
 	/// @}
 
 private:
@@ -511,8 +576,9 @@ private:
 	dtNavMeshQuery& operator=(const dtNavMeshQuery&);
 
 	/// Queries polygons within a tile.
+	template <class Filter>
 	void queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
-							 const dtQueryFilter* filter, dtPolyQuery* query) const;
+							 const Filter* filter, dtPolyQuery* query) const;
 
 	/// Returns portal points between two polygons.
 	dtStatus getPortalPoints(dtPolyRef from, dtPolyRef to, float* left, float* right,
@@ -521,12 +587,6 @@ private:
 							 dtPolyRef to, const dtPoly* toPoly, const dtMeshTile* toTile,
 							 float* left, float* right) const;
 
-	/// Returns edge mid point between two polygons.
-	dtStatus getEdgeMidPoint(dtPolyRef from, dtPolyRef to, float* mid) const;
-	dtStatus getEdgeMidPoint(dtPolyRef from, const dtPoly* fromPoly, const dtMeshTile* fromTile,
-							 dtPolyRef to, const dtPoly* toPoly, const dtMeshTile* toTile,
-							 float* mid) const;
-
 	// Appends vertex to a straight path
 	dtStatus appendVertex(const float* pos, const unsigned char flags, const dtPolyRef ref,
 						  float* straightPath, unsigned char* straightPathFlags, dtPolyRef* straightPathRefs,
@@ -555,8 +615,8 @@ private:
 	};
 	dtQueryData m_query;				///< Sliced query state.
 
-	class dtNodePool* m_tinyNodePool;	///< Pointer to small node pool.
-	class dtNodePool* m_nodePool;		///< Pointer to node pool.
+	dtQueryNodePool* m_tinyNodePool;	///< Pointer to small node pool.
+	dtQueryNodePool* m_nodePool;		///< Pointer to node pool.
 	class dtNodeQueue* m_openList;		///< Pointer to open list queue.
 };
 
@@ -570,4 +630,7 @@ dtNavMeshQuery* dtAllocNavMeshQuery();
 /// @ingroup detour
 void dtFreeNavMeshQuery(dtNavMeshQuery* query);
 
+// Definitions of the filter-templated query members.
+#include "DetourNavMeshQueryImpl.h"
+
 #endif // DETOURNAVMESHQUERY_H
@@ -105,6 +105,94 @@ private:
 	int m_nodeCount;
 };
 
+/// A node pool with the same interface as dtNodePool, where clearing doesn't
+/// touch the hash table.
+///
+/// The table is open addressed with linear probing, and each slot is stamped
+/// with the query that filled it. Clearing just starts a new stamp, so slots
+/// from earlier queries read as empty, and the table only has to be wiped
+/// when the stamp wraps around. The table is kept at least twice the size of
+/// the node pool, so probe sequences stay short.
+///
+/// Nodes are allocated in the same order as dtNodePool, and findNodes()
+/// returns them in the same order, so searches give identical results with
+/// either pool.
+class dtStampedNodePool
+{
+public:
+	/// @param[in]	maxNodes	The number of nodes in the pool.
+	/// @param[in]	hashSize	The minimum hash table size, rounded up to a
+	///							power of two at least twice @p maxNodes.
+	dtStampedNodePool(int maxNodes, int hashSize);
+	~dtStampedNodePool();
+	void clear();
+
+	// Get a dtNode by ref and extra state information. If there is none then - allocate
+	// There can be more than one node for the same polyRef but with different extra state information
+	dtNode* getNode(dtPolyRef id, unsigned char state=0);
+	dtNode* findNode(dtPolyRef id, unsigned char state);
+	unsigned int findNodes(dtPolyRef id, dtNode** nodes, const int maxNodes);
+
+	inline unsigned int getNodeIdx(const dtNode* node) const
+	{
+		if (!node) return 0;
+		return (unsigned int)(node - m_nodes) + 1;
+	}
+
+	inline dtNode* getNodeAtIdx(unsigned int idx)
+	{
+		if (!idx) return 0;
+		return &m_nodes[idx - 1];
+	}
+
+	inline const dtNode* getNodeAtIdx(unsigned int idx) const
+	{
+		if (!idx) return 0;
+		return &m_nodes[idx - 1];
+	}
+
+	inline int getMemUsed() const
+	{
+		return sizeof(*this) +
+			sizeof(dtNode)*m_maxNodes +
+			sizeof(dtNodeSlot)*m_hashSize;
+	}
+
+	inline int getMaxNodes() const { return m_maxNodes; }
+
+	inline int getHashSize() const { return m_hashSize; }
+	inline int getNodeCount() const { return m_nodeCount; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtStampedNodePool(const dtStampedNodePool&);
+	dtStampedNodePool& operator=(const dtStampedNodePool&);
+
+	/// A hash table slot, holding the node's polygon ref so probing only
+	/// touches the table. Empty unless stamp is the pool's current stamp.
+	struct dtNodeSlot
+	{
+		dtPolyRef id;
+		unsigned short stamp;
+		dtNodeIndex idx;
+	};
+
+	dtNode* m_nodes;
+	dtNodeSlot* m_slots;
+	const int m_maxNodes;
+	const int m_hashSize;
+	int m_nodeCount;
+	unsigned short m_stamp;
+};
+
+// Define DT_STAMPED_NODEPOOL to have dtNavMeshQuery use dtStampedNodePool
+// instead of dtNodePool.
+#ifdef DT_STAMPED_NODEPOOL
+typedef dtStampedNodePool dtQueryNodePool;
+#else
+typedef dtNodePool dtQueryNodePool;
+#endif
+
 class dtNodeQueue
 {
 public:
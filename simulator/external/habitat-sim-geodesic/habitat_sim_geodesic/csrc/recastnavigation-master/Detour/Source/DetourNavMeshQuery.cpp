@@ -100,7 +100,7 @@ inline float dtQueryFilter::getCost(const float* pa, const float* pb,
 }
 #endif
 
-static const float H_SCALE = 0.999f; // Search heuristic scale.
+static const float H_SCALE = DT_FINDPATH_H_SCALE; // Search heuristic scale.
 
 dtNavMeshQuery* dtAllocNavMeshQuery()
 {
@@ -146,9 +146,9 @@ dtNavMeshQuery::dtNavMeshQuery() :
 dtNavMeshQuery::~dtNavMeshQuery()
 {
 	if (m_tinyNodePool)
-		m_tinyNodePool->~dtNodePool();
+		m_tinyNodePool->~dtQueryNodePool();
 	if (m_nodePool)
-		m_nodePool->~dtNodePool();
+		m_nodePool->~dtQueryNodePool();
 	if (m_openList)
 		m_openList->~dtNodeQueue();
 	dtFree(m_tinyNodePool);
@@ -173,11 +173,11 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 	{
 		if (m_nodePool)
 		{
-			m_nodePool->~dtNodePool();
+			m_nodePool->~dtQueryNodePool();
 			dtFree(m_nodePool);
 			m_nodePool = 0;
 		}
-		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(maxNodes/4));
+		m_nodePool = new (dtAlloc(sizeof(dtQueryNodePool), DT_ALLOC_PERM)) dtQueryNodePool(maxNodes, dtNextPow2(maxNodes/4));
 		if (!m_nodePool)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
@@ -188,7 +188,7 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 
 	if (!m_tinyNodePool)
 	{
-		m_tinyNodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(64, 32);
+		m_tinyNodePool = new (dtAlloc(sizeof(dtQueryNodePool), DT_ALLOC_PERM)) dtQueryNodePool(64, 32);
 		if (!m_tinyNodePool)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
@@ -622,60 +622,6 @@ dtStatus dtNavMeshQuery::getPolyHeight(dtPolyRef ref, const float* pos, float* h
 		: DT_FAILURE | DT_INVALID_PARAM;
 }
 
-class dtFindNearestPolyQuery : public dtPolyQuery
-{
-	const dtNavMeshQuery* m_query;
-	const float* m_center;
-	float m_nearestDistanceSqr;
-	dtPolyRef m_nearestRef;
-	float m_nearestPoint[3];
-
-public:
-	dtFindNearestPolyQuery(const dtNavMeshQuery* query, const float* center)
-		: m_query(query), m_center(center), m_nearestDistanceSqr(FLT_MAX), m_nearestRef(0), m_nearestPoint()
-	{
-	}
-
-	dtPolyRef nearestRef() const { return m_nearestRef; }
-	const float* nearestPoint() const { return m_nearestPoint; }
-
-	void process(const dtMeshTile* tile, dtPoly** polys, dtPolyRef* refs, int count)
-	{
-		dtIgnoreUnused(polys);
-
-		for (int i = 0; i < count; ++i)
-		{
-			dtPolyRef ref = refs[i];
-			float closestPtPoly[3];
-			float diff[3];
-			bool posOverPoly = false;
-			float d;
-			m_query->closestPointOnPoly(ref, m_center, closestPtPoly, &posOverPoly);
-
-			// If a point is directly over a polygon and closer than
-			// climb height, favor that instead of straight line nearest point.
-			dtVsub(diff, m_center, closestPtPoly);
-			if (posOverPoly)
-			{
-				d = dtAbs(diff[1]) - tile->header->walkableClimb;
-				d = d > 0 ? d*d : 0;
-			}
-			else
-			{
-				d = dtVlenSqr(diff);
-			}
-
-			if (d < m_nearestDistanceSqr)
-			{
-				dtVcopy(m_nearestPoint, closestPtPoly);
-
-				m_nearestDistanceSqr = d;
-				m_nearestRef = ref;
-			}
-		}
-	}
-};
-
 /// @par
 ///
 /// @note If the search box does not intersect any polygons the search will
@@ -686,143 +632,7 @@ dtStatus dtNavMeshQuery::findNearestPoly(const float* center, const float* halfE
 										 const dtQueryFilter* filter,
 										 dtPolyRef* nearestRef, float* nearestPt) const
 {
-	dtAssert(m_nav);
-
-	if (!nearestRef)
-		return DT_FAILURE | DT_INVALID_PARAM;
-
-	// queryPolygons below will check rest of params
-
-	dtFindNearestPolyQuery query(this, center);
-
-	dtStatus status = queryPolygons(center, halfExtents, filter, &query);
-	if (dtStatusFailed(status))
-		return status;
-
-	*nearestRef = query.nearestRef();
-	// Only override nearestPt if we actually found a poly so the nearest point
-	// is valid.
-	if (nearestPt && *nearestRef)
-		dtVcopy(nearestPt, query.nearestPoint());
-
-	return DT_SUCCESS;
-}
-
-void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
-										 const dtQueryFilter* filter, dtPolyQuery* query) const
-{
-	dtAssert(m_nav);
-	static const int batchSize = 32;
-	dtPolyRef polyRefs[batchSize];
-	dtPoly* polys[batchSize];
-	int n = 0;
-
-	if (tile->bvTree)
-	{
-		const dtBVNode* node = &tile->bvTree[0];
-		const dtBVNode* end = &tile->bvTree[tile->header->bvNodeCount];
-		const float* tbmin = tile->header->bmin;
-		const float* tbmax = tile->header->bmax;
-		const float qfac = tile->header->bvQuantFactor;
-
-		// Calculate quantized box
-		unsigned short bmin[3], bmax[3];
-		// dtClamp query box to world box.
-		float minx = dtClamp(qmin[0], tbmin[0], tbmax[0]) - tbmin[0];
-		float miny = dtClamp(qmin[1], tbmin[1], tbmax[1]) - tbmin[1];
-		float minz = dtClamp(qmin[2], tbmin[2], tbmax[2]) - tbmin[2];
-		float maxx = dtClamp(qmax[0], tbmin[0], tbmax[0]) - tbmin[0];
-		float maxy = dtClamp(qmax[1], tbmin[1], tbmax[1]) - tbmin[1];
-		float maxz = dtClamp(qmax[2], tbmin[2], tbmax[2]) - tbmin[2];
-		// Quantize
-		bmin[0] = (unsigned short)(qfac * minx) & 0xfffe;
-		bmin[1] = (unsigned short)(qfac * miny) & 0xfffe;
-		bmin[2] = (unsigned short)(qfac * minz) & 0xfffe;
-		bmax[0] = (unsigned short)(qfac * maxx + 1) | 1;
-		bmax[1] = (unsigned short)(qfac * maxy + 1) | 1;
-		bmax[2] = (unsigned short)(qfac * maxz + 1) | 1;
-
-		// Traverse tree
-		const dtPolyRef base = m_nav->getPolyRefBase(tile);
-		while (node < end)
-		{
-			const bool overlap = dtOverlapQuantBounds(bmin, bmax, node->bmin, node->bmax);
-			const bool isLeafNode = node->i >= 0;
-
-			if (isLeafNode && overlap)
-			{
-				dtPolyRef ref = base | (dtPolyRef)node->i;
-				if (filter->passFilter(ref, tile, &tile->polys[node->i]))
-				{
-					polyRefs[n] = ref;
-					polys[n] = &tile->polys[node->i];
-
-					if (n == batchSize - 1)
-					{
-						query->process(tile, polys, polyRefs, batchSize);
-						n = 0;
-					}
-					else
-					{
-						n++;
-					}
-				}
-			}
-
-			if (overlap || isLeafNode)
-				node++;
-			else
-			{
-				const int escapeIndex = -node->i;
-				node += escapeIndex;
-			}
-		}
-	}
-	else
-	{
-		float bmin[3], bmax[3];
-		const dtPolyRef base = m_nav->getPolyRefBase(tile);
-		for (int i = 0; i < tile->header->polyCount; ++i)
-		{
-			dtPoly* p = &tile->polys[i];
-			// Do not return off-mesh connection polygons.
-			if (p->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
-				continue;
-			// Must pass filter
-			const dtPolyRef ref = base | (dtPolyRef)i;
-			if (!filter->passFilter(ref, tile, p))
-				continue;
-			// Calc polygon bounds.
-			const float* v = &tile->verts[p->verts[0]*3];
-			dtVcopy(bmin, v);
-			dtVcopy(bmax, v);
-			for (int j = 1; j < p->vertCount; ++j)
-			{
-				v = &tile->verts[p->verts[j]*3];
-				dtVmin(bmin, v);
-				dtVmax(bmax, v);
-			}
-			if (dtOverlapBounds(qmin, qmax, bmin, bmax))
-			{
-				polyRefs[n] = ref;
-				polys[n] = p;
-
-				if (n == batchSize - 1)
-				{
-					query->process(tile, polys, polyRefs, batchSize);
-					n = 0;
-				}
-				else
-				{
-					n++;
-				}
-			}
-		}
-	}
-
-	// Process the last polygons that didn't make a full batch.
-	if (n > 0)
-		query->process(tile, polys, polyRefs, n);
+	return findNearestPoly<dtQueryFilter>(center, halfExtents, filter, nearestRef, nearestPt);
 }
 
 class dtCollectPolysQuery : public dtPolyQuery
@@ -895,40 +705,7 @@ dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExt
 dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExtents,
 									   const dtQueryFilter* filter, dtPolyQuery* query) const
 {
-	dtAssert(m_nav);
-
-	if (!center || !dtVisfinite(center) ||
-		!halfExtents || !dtVisfinite(halfExtents) ||
-		!filter || !query)
-	{
-		return DT_FAILURE | DT_INVALID_PARAM;
-	}
-
-	float bmin[3], bmax[3];
-	dtVsub(bmin, center, halfExtents);
-	dtVadd(bmax, center, halfExtents);
-
-	// Find tiles the query touches.
-	int minx, miny, maxx, maxy;
-	m_nav->calcTileLoc(bmin, &minx, &miny);
-	m_nav->calcTileLoc(bmax, &maxx, &maxy);
-
-	static const int MAX_NEIS = 32;
-	const dtMeshTile* neis[MAX_NEIS];
-
-	for (int y = miny; y <= maxy; ++y)
-	{
-		for (int x = minx; x <= maxx; ++x)
-		{
-			const int nneis = m_nav->getTilesAt(x,y,neis,MAX_NEIS);
-			for (int j = 0; j < nneis; ++j)
-			{
-				queryPolygonsInTile(neis[j], bmin, bmax, filter, query);
-			}
-		}
-	}
-
-	return DT_SUCCESS;
+	return queryPolygons<dtQueryFilter>(center, halfExtents, filter, query);
 }
 
 /// @par
@@ -947,193 +724,7 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 								  const dtQueryFilter* filter,
 								  dtPolyRef* path, int* pathCount, const int maxPath) const
 {
-	dtAssert(m_nav);
-	dtAssert(m_nodePool);
-	dtAssert(m_openList);
-
-	if (!pathCount)
-		return DT_FAILURE | DT_INVALID_PARAM;
-
-	*pathCount = 0;
-
-	// Validate input
-	if (!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
-		!startPos || !dtVisfinite(startPos) ||
-		!endPos || !dtVisfinite(endPos) ||
-		!filter || !path || maxPath <= 0)
-	{
-		return DT_FAILURE | DT_INVALID_PARAM;
-	}
-
-	if (startRef == endRef)
-	{
-		path[0] = startRef;
-		*pathCount = 1;
-		return DT_SUCCESS;
-	}
-
-	m_nodePool->clear();
-	m_openList->clear();
-
-	dtNode* startNode = m_nodePool->getNode(startRef);
-	dtVcopy(startNode->pos, startPos);
-	startNode->pidx = 0;
-	startNode->cost = 0;
-	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
-	startNode->id = startRef;
-	startNode->flags = DT_NODE_OPEN;
-	m_openList->push(startNode);
-
-	dtNode* lastBestNode = startNode;
-	float lastBestNodeCost = startNode->total;
-
-	bool outOfNodes = false;
-
-	while (!m_openList->empty())
-	{
-		// Remove node from open list and put it in closed list.
-		dtNode* bestNode = m_openList->pop();
-		bestNode->flags &= ~DT_NODE_OPEN;
-		bestNode->flags |= DT_NODE_CLOSED;
-
-		// Reached the goal, stop searching.
-		if (bestNode->id == endRef)
-		{
-			lastBestNode = bestNode;
-			break;
-		}
-
-		// Get current poly and tile.
-		// The API input has been cheked already, skip checking internal data.
-		const dtPolyRef bestRef = bestNode->id;
-		const dtMeshTile* bestTile = 0;
-		const dtPoly* bestPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
-
-		// Get parent poly and tile.
-		dtPolyRef parentRef = 0;
-		const dtMeshTile* parentTile = 0;
-		const dtPoly* parentPoly = 0;
-		if (bestNode->pidx)
-			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
-		if (parentRef)
-			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
-
-		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
-		{
-			dtPolyRef neighbourRef = bestTile->links[i].ref;
-
-			// Skip invalid ids and do not expand back to where we came from.
-			if (!neighbourRef || neighbourRef == parentRef)
-				continue;
-
-			// Get neighbour poly and tile.
-			// The API input has been cheked already, skip checking internal data.
-			const dtMeshTile* neighbourTile = 0;
-			const dtPoly* neighbourPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
-
-			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
-				continue;
-
-			// deal explicitly with crossing tile boundaries
-			unsigned char crossSide = 0;
-			if (bestTile->links[i].side != 0xff)
-				crossSide = bestTile->links[i].side >> 1;
-
-			// get the node
-			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, crossSide);
-			if (!neighbourNode)
-			{
-				outOfNodes = true;
-				continue;
-			}
-
-			// If the node is visited the first time, calculate node position.
-			if (neighbourNode->flags == 0)
-			{
-				getEdgeMidPoint(bestRef, bestPoly, bestTile,
-								neighbourRef, neighbourPoly, neighbourTile,
-								neighbourNode->pos);
-			}
-
-			// Calculate cost and heuristic.
-			float cost = 0;
-			float heuristic = 0;
-
-			// Special case for last node.
-			if (neighbourRef == endRef)
-			{
-				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
-													  parentRef, parentTile, parentPoly,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly);
-				const float endCost = filter->getCost(neighbourNode->pos, endPos,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly,
-													  0, 0, 0);
-
-				cost = bestNode->cost + curCost + endCost;
-				heuristic = 0;
-			}
-			else
-			{
-				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
-													  parentRef, parentTile, parentPoly,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly);
-				cost = bestNode->cost + curCost;
-				heuristic = dtVdist(neighbourNode->pos, endPos)*H_SCALE;
-			}
-
-			const float total = cost + heuristic;
-
-			// The node is already in open list and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
-				continue;
-			// The node is already visited and process, and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
-				continue;
-
-			// Add or update the node.
-			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
-			neighbourNode->id = neighbourRef;
-			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
-			neighbourNode->cost = cost;
-			neighbourNode->total = total;
-
-			if (neighbourNode->flags & DT_NODE_OPEN)
-			{
-				// Already in open, update node location.
-				m_openList->modify(neighbourNode);
-			}
-			else
-			{
-				// Put the node in open list.
-				neighbourNode->flags |= DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
-			}
-
-			// Update nearest node to target so far.
-			if (heuristic < lastBestNodeCost)
-			{
-				lastBestNodeCost = heuristic;
-				lastBestNode = neighbourNode;
-			}
-		}
-	}
-
-	dtStatus status = getPathToNode(lastBestNode, path, pathCount, maxPath);
-
-	if (lastBestNode->id != endRef)
-		status |= DT_PARTIAL_RESULT;
-
-	if (outOfNodes)
-		status |= DT_OUT_OF_NODES;
-
-	return status;
+	return findPath<dtQueryFilter>(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
 }
 
 
@@ -1993,265 +1584,225 @@ dtStatus dtNavMeshQuery::findStraightPath(const float* startPos, const float* en
 	return DT_SUCCESS | ((*straightPathCount >= maxStraightPath) ? DT_BUFFER_TOO_SMALL : 0);
 }
 
+// Accumulates the length of a straight path in place of appendVertex, so
+// findStraightPathLength never has to store the path points.
+struct dtStraightPathLength
+{
+	float last[3];
+	float length;
+	int count;
+	int maxCount;
+
+	dtStatus append(const float* pos, const unsigned char flags)
+	{
+		if (count > 0 && dtVequal(last, pos))
+			return DT_IN_PROGRESS;
+
+		if (count > 0)
+			length += dtVdist(last, pos);
+		dtVcopy(last, pos);
+		count++;
+
+		if (count >= maxCount)
+			return DT_SUCCESS | DT_BUFFER_TOO_SMALL;
+
+		if (flags == DT_STRAIGHTPATH_END)
+			return DT_SUCCESS;
+
+		return DT_IN_PROGRESS;
+	}
+};
+
 /// @par
 ///
-/// This method is optimized for small delta movement and a small number of
-/// polygons. If used for too great a distance, the result set will form an
-/// incomplete path.
-///
-/// @p resultPos will equal the @p endPos if the end is reached.
-/// Otherwise the closest reachable position will be returned.
-///
-/// @p resultPos is not projected onto the surface of the navigation
-/// mesh. Use #getPolyHeight if this is needed.
+/// Runs the same string pulling as #findStraightPath with no options, but
+/// only sums the distance between consecutive path points. The point count
+/// is still tracked so the returned status (including #DT_BUFFER_TOO_SMALL)
+/// is the same as #findStraightPath would return with a buffer of
+/// @p maxStraightPath points.
 ///
-/// This method treats the end position in the same manner as
-/// the #raycast method. (As a 2D point.) See that method's documentation
-/// for details.
-///
-/// If the @p visited array is too small to hold the entire result set, it will
-/// be filled as far as possible from the start position toward the end
-/// position.
-///
-dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* startPos, const float* endPos,
-										  const dtQueryFilter* filter,
-										  float* resultPos, dtPolyRef* visited, int* visitedCount, const int maxVisitedSize, bool allowSliding) const
+dtStatus dtNavMeshQuery::findStraightPathLength(const float* startPos, const float* endPos,
+												const dtPolyRef* path, const int pathSize,
+												float* pathLength, int* straightPathCount, const int maxStraightPath) const
 {
 	dtAssert(m_nav);
-	dtAssert(m_tinyNodePool);
 
-	if (!visitedCount)
+	if (!pathLength || !straightPathCount)
 		return DT_FAILURE | DT_INVALID_PARAM;
 
-	*visitedCount = 0;
+	*pathLength = 0;
+	*straightPathCount = 0;
 
-	if (!m_nav->isValidPolyRef(startRef) ||
-		!startPos || !dtVisfinite(startPos) ||
+	if (!startPos || !dtVisfinite(startPos) ||
 		!endPos || !dtVisfinite(endPos) ||
-		!filter || !resultPos || !visited ||
-		maxVisitedSize <= 0)
+		!path || pathSize <= 0 || !path[0] ||
+		maxStraightPath <= 0)
 	{
 		return DT_FAILURE | DT_INVALID_PARAM;
 	}
 
-	dtStatus status = DT_SUCCESS;
-
-	static const int MAX_STACK = 48;
-	dtNode* stack[MAX_STACK];
-	int nstack = 0;
-
-	m_tinyNodePool->clear();
-
-	dtNode* startNode = m_tinyNodePool->getNode(startRef);
-	startNode->pidx = 0;
-	startNode->cost = 0;
-	startNode->total = 0;
-	startNode->id = startRef;
-	startNode->flags = DT_NODE_CLOSED;
-	stack[nstack++] = startNode;
+	dtStatus stat = 0;
+	dtStraightPathLength result;
+	result.length = 0;
+	result.count = 0;
+	result.maxCount = maxStraightPath;
 
-	float bestPos[3];
-	float bestDist = FLT_MAX;
-	dtNode* bestNode = 0;
-	dtVcopy(bestPos, startPos);
+	float closestStartPos[3];
+	if (dtStatusFailed(closestPointOnPolyBoundary(path[0], startPos, closestStartPos)))
+		return DT_FAILURE | DT_INVALID_PARAM;
 
-	// Search constraints
-	float searchPos[3], searchRadSqr;
-	dtVlerp(searchPos, startPos, endPos, 0.5f);
-	searchRadSqr = dtSqr(dtVdist(startPos, endPos)/2.0f + 0.001f);
+	float closestEndPos[3];
+	if (dtStatusFailed(closestPointOnPolyBoundary(path[pathSize-1], endPos, closestEndPos)))
+		return DT_FAILURE | DT_INVALID_PARAM;
 
-	float verts[DT_VERTS_PER_POLYGON*3];
+	// Add start point.
+	stat = result.append(closestStartPos, DT_STRAIGHTPATH_START);
 
-	while (nstack)
+	if (stat == DT_IN_PROGRESS && pathSize > 1)
 	{
-		// Pop front.
-		dtNode* curNode = stack[0];
-		for (int i = 0; i < nstack-1; ++i)
-			stack[i] = stack[i+1];
-		nstack--;
-
-		// Get poly and tile.
-		// The API input has been cheked already, skip checking internal data.
-		const dtPolyRef curRef = curNode->id;
-		const dtMeshTile* curTile = 0;
-		const dtPoly* curPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(curRef, &curTile, &curPoly);
-
-		// Collect vertices.
-		const int nverts = curPoly->vertCount;
-		for (int i = 0; i < nverts; ++i)
-			dtVcopy(&verts[i*3], &curTile->verts[curPoly->verts[i]*3]);
+		float portalApex[3], portalLeft[3], portalRight[3];
+		dtVcopy(portalApex, closestStartPos);
+		dtVcopy(portalLeft, portalApex);
+		dtVcopy(portalRight, portalApex);
+		int apexIndex = 0;
+		int leftIndex = 0;
+		int rightIndex = 0;
 
-		// If target is inside the poly, stop search.
-		if (dtPointInPolygon(endPos, verts, nverts))
-		{
-			bestNode = curNode;
-			dtVcopy(bestPos, endPos);
-			break;
-		}
+		dtPolyRef leftPolyRef = path[0];
+		dtPolyRef rightPolyRef = path[0];
 
-		// Find wall edges and find nearest point inside the walls.
-		for (int i = 0, j = (int)curPoly->vertCount-1; i < (int)curPoly->vertCount; j = i++)
+		for (int i = 0; i < pathSize && stat == DT_IN_PROGRESS; ++i)
 		{
-			// Find links to neighbours.
-			static const int MAX_NEIS = 8;
-			int nneis = 0;
-			dtPolyRef neis[MAX_NEIS];
+			float left[3], right[3];
+			unsigned char fromType, toType;
 
-			if (curPoly->neis[j] & DT_EXT_LINK)
+			if (i+1 < pathSize)
 			{
-				// Tile border.
-				for (unsigned int k = curPoly->firstLink; k != DT_NULL_LINK; k = curTile->links[k].next)
+				// Next portal.
+				if (dtStatusFailed(getPortalPoints(path[i], path[i+1], left, right, fromType, toType)))
 				{
-					const dtLink* link = &curTile->links[k];
-					if (link->edge == j)
-					{
-						if (link->ref != 0)
-						{
-							const dtMeshTile* neiTile = 0;
-							const dtPoly* neiPoly = 0;
-							m_nav->getTileAndPolyByRefUnsafe(link->ref, &neiTile, &neiPoly);
-							if (filter->passFilter(link->ref, neiTile, neiPoly))
-							{
-								if (nneis < MAX_NEIS)
-									neis[nneis++] = link->ref;
-							}
-						}
-					}
+					// path[i+1] is invalid, clamp the end point to path[i].
+					if (dtStatusFailed(closestPointOnPolyBoundary(path[i], endPos, closestEndPos)))
+						return DT_FAILURE | DT_INVALID_PARAM;
+
+					result.append(closestEndPos, 0);
+
+					*pathLength = result.length;
+					*straightPathCount = result.count;
+					return DT_SUCCESS | DT_PARTIAL_RESULT | ((result.count >= maxStraightPath) ? DT_BUFFER_TOO_SMALL : 0);
 				}
-			}
-			else if (curPoly->neis[j])
-			{
-				const unsigned int idx = (unsigned int)(curPoly->neis[j]-1);
-				const dtPolyRef ref = m_nav->getPolyRefBase(curTile) | idx;
-				if (filter->passFilter(ref, curTile, &curTile->polys[idx]))
+
+				// If starting really close the portal, advance.
+				if (i == 0)
 				{
-					// Internal edge, encode id.
-					neis[nneis++] = ref;
+					float t;
+					if (dtDistancePtSegSqr2D(portalApex, left, right, t) < dtSqr(0.001f))
+						continue;
 				}
 			}
-
-			if (!nneis)
+			else
 			{
-				// Wall edge, calc distance.
-				const float* vj = &verts[j*3];
-				const float* vi = &verts[i*3];
+				// End of the path.
+				dtVcopy(left, closestEndPos);
+				dtVcopy(right, closestEndPos);
+			}
 
-				if (!allowSliding)
+			// Right vertex.
+			if (dtTriArea2D(portalApex, portalRight, right) <= 0.0f)
+			{
+				if (dtVequal(portalApex, portalRight) || dtTriArea2D(portalApex, portalLeft, right) > 0.0f)
 				{
-						float s, t;
-						if (dtIntersectSegSeg2D(vj, vi, startPos, endPos, s, t)
-								&& t >= 0 && t <= 1 && s >= 0 && s <= 1)
-						{
-							// If sliding is not allowed, then the candidate end position will be
-							// where startPos -> endPos and vj -> vi intersect
-							float newPos[3];
-							dtVlerp(newPos, vj, vi, s);
-							const float distSqr = dtVdist2DSqr(newPos, endPos);
-
-							if (distSqr < bestDist)
-							{
-								dtVcopy(bestPos, newPos);
-								bestDist = distSqr;
-								bestNode = curNode;
-							}
-						}
+					dtVcopy(portalRight, right);
+					rightPolyRef = (i+1 < pathSize) ? path[i+1] : 0;
+					rightIndex = i;
 				}
 				else
 				{
-					float tseg;
-					const float distSqr = dtDistancePtSegSqr2D(endPos, vj, vi, tseg);
+					dtVcopy(portalApex, portalLeft);
+					apexIndex = leftIndex;
 
-					if (distSqr < bestDist)
-					{
+					stat = result.append(portalApex, leftPolyRef ? 0 : DT_STRAIGHTPATH_END);
 
-						// Update nearest distance.
-						dtVlerp(bestPos, vj, vi, tseg);
-						bestDist = distSqr;
-						bestNode = curNode;
-					}
+					dtVcopy(portalLeft, portalApex);
+					dtVcopy(portalRight, portalApex);
+					leftIndex = apexIndex;
+					rightIndex = apexIndex;
+
+					// Restart
+					i = apexIndex;
+
+					continue;
 				}
 			}
-			else
+
+			// Left vertex.
+			if (dtTriArea2D(portalApex, portalLeft, left) >= 0.0f)
 			{
-				for (int k = 0; k < nneis; ++k)
+				if (dtVequal(portalApex, portalLeft) || dtTriArea2D(portalApex, portalRight, left) < 0.0f)
 				{
-					// Skip if no node can be allocated.
-					dtNode* neighbourNode = m_tinyNodePool->getNode(neis[k]);
-					if (!neighbourNode)
-						continue;
-					// Skip if already visited.
-					if (neighbourNode->flags & DT_NODE_CLOSED)
-						continue;
+					dtVcopy(portalLeft, left);
+					leftPolyRef = (i+1 < pathSize) ? path[i+1] : 0;
+					leftIndex = i;
+				}
+				else
+				{
+					dtVcopy(portalApex, portalRight);
+					apexIndex = rightIndex;
 
-					// Skip the link if it is too far from search constraint.
-					// TODO: Maybe should use getPortalPoints(), but this one is way faster.
-					const float* vj = &verts[j*3];
-					const float* vi = &verts[i*3];
-					float tseg;
-					float distSqr = dtDistancePtSegSqr2D(searchPos, vj, vi, tseg);
-					if (distSqr > searchRadSqr)
-						continue;
+					stat = result.append(portalApex, rightPolyRef ? 0 : DT_STRAIGHTPATH_END);
 
-					if (!allowSliding)
-					{
-						float s, t;
-						// If sliding is not allowed, then we need to be able to travel along
-						// startPos -> endPos and intersect the edge of the polygon vj -> vi
-						if (!(dtIntersectSegSeg2D(vj, vi, startPos, endPos, s, t)
-								&& t >= 0 && t <= 1 && s >= 0 && s <= 1))
-						{
-							continue;
-						}
-					}
+					dtVcopy(portalLeft, portalApex);
+					dtVcopy(portalRight, portalApex);
+					leftIndex = apexIndex;
+					rightIndex = apexIndex;
 
-					// Mark as the node as visited and push to queue.
-					if (nstack < MAX_STACK)
-					{
-						neighbourNode->pidx = m_tinyNodePool->getNodeIdx(curNode);
-						neighbourNode->flags |= DT_NODE_CLOSED;
-						stack[nstack++] = neighbourNode;
-					}
+					// Restart
+					i = apexIndex;
+
+					continue;
 				}
 			}
 		}
 	}
 
-	int n = 0;
-	if (bestNode)
-	{
-		// Reverse the path.
-		dtNode* prev = 0;
-		dtNode* node = bestNode;
-		do
-		{
-			dtNode* next = m_tinyNodePool->getNodeAtIdx(node->pidx);
-			node->pidx = m_tinyNodePool->getNodeIdx(prev);
-			prev = node;
-			node = next;
-		}
-		while (node);
+	if (stat == DT_IN_PROGRESS)
+		result.append(closestEndPos, DT_STRAIGHTPATH_END);
 
-		// Store result
-		node = prev;
-		do
-		{
-			visited[n++] = node->id;
-			if (n >= maxVisitedSize)
-			{
-				status |= DT_BUFFER_TOO_SMALL;
-				break;
-			}
-			node = m_tinyNodePool->getNodeAtIdx(node->pidx);
-		}
-		while (node);
-	}
+	*pathLength = result.length;
+	*straightPathCount = result.count;
 
-	dtVcopy(resultPos, bestPos);
+	if (stat != DT_IN_PROGRESS)
+		return stat;
 
-	*visitedCount = n;
+	return DT_SUCCESS | ((result.count >= maxStraightPath) ? DT_BUFFER_TOO_SMALL : 0);
+}
 
-	return status;
+/// @par
+///
+/// This method is optimized for small delta movement and a small number of
+/// polygons. If used for too great a distance, the result set will form an
+/// incomplete path.
+///
+/// @p resultPos will equal the @p endPos if the end is reached.
+/// Otherwise the closest reachable position will be returned.
+///
+/// @p resultPos is not projected onto the surface of the navigation
+/// mesh. Use #getPolyHeight if this is needed.
+///
+/// This method treats the end position in the same manner as
+/// the #raycast method. (As a 2D point.) See that method's documentation
+/// for details.
+///
+/// If the @p visited array is too small to hold the entire result set, it will
+/// be filled as far as possible from the start position toward the end
+/// position.
+///
+dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* startPos, const float* endPos,
+										  const dtQueryFilter* filter,
+										  float* resultPos, dtPolyRef* visited, int* visitedCount, const int maxVisitedSize, bool allowSliding) const
+{
+	return moveAlongSurface<dtQueryFilter>(startRef, startPos, endPos, filter,
+											resultPos, visited, visitedCount, maxVisitedSize, allowSliding);
 }
 
 
@@ -152,6 +152,117 @@ dtNode* dtNodePool::getNode(dtPolyRef id, unsigned char state)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+dtStampedNodePool::dtStampedNodePool(int maxNodes, int hashSize) :
+	m_nodes(0),
+	m_slots(0),
+	m_maxNodes(maxNodes),
+	m_hashSize((int)dtNextPow2((unsigned int)dtMax(hashSize, maxNodes*2))),
+	m_nodeCount(0),
+	m_stamp(1)
+{
+	// pidx is special as 0 means "none" and 1 is the first node. For that reason
+	// we have 1 fewer nodes available than the number of values it can contain.
+	dtAssert(m_maxNodes > 0 && m_maxNodes <= DT_NULL_IDX && m_maxNodes <= (1 << DT_NODE_PARENT_BITS) - 1);
+
+	m_nodes = (dtNode*)dtAlloc(sizeof(dtNode)*m_maxNodes, DT_ALLOC_PERM);
+	m_slots = (dtNodeSlot*)dtAlloc(sizeof(dtNodeSlot)*m_hashSize, DT_ALLOC_PERM);
+
+	dtAssert(m_nodes);
+	dtAssert(m_slots);
+
+	memset(m_slots, 0, sizeof(dtNodeSlot)*m_hashSize);
+}
+
+dtStampedNodePool::~dtStampedNodePool()
+{
+	dtFree(m_nodes);
+	dtFree(m_slots);
+}
+
+void dtStampedNodePool::clear()
+{
+	m_nodeCount = 0;
+
+	// Stamp 0 is never current, so wiping the table back to it empties every slot
+	m_stamp++;
+	if (m_stamp == 0)
+	{
+		memset(m_slots, 0, sizeof(dtNodeSlot)*m_hashSize);
+		m_stamp = 1;
+	}
+}
+
+unsigned int dtStampedNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNodes)
+{
+	// A ref has at most one node per state, and later nodes sit further along
+	// the probe sequence. Collect them all so they can be returned newest
+	// first, like dtNodePool does.
+	dtNodeIndex found[DT_MAX_STATES_PER_NODE];
+	int nfound = 0;
+
+	const unsigned int mask = (unsigned int)m_hashSize - 1;
+	for (unsigned int slot = dtHashRef(id) & mask; m_slots[slot].stamp == m_stamp; slot = (slot+1) & mask)
+	{
+		if (m_slots[slot].id == id && nfound < DT_MAX_STATES_PER_NODE)
+			found[nfound++] = m_slots[slot].idx;
+	}
+
+	int n = 0;
+	while (nfound > 0 && n < maxNodes)
+		nodes[n++] = &m_nodes[found[--nfound]];
+
+	return n;
+}
+
+dtNode* dtStampedNodePool::findNode(dtPolyRef id, unsigned char state)
+{
+	const unsigned int mask = (unsigned int)m_hashSize - 1;
+	for (unsigned int slot = dtHashRef(id) & mask; m_slots[slot].stamp == m_stamp; slot = (slot+1) & mask)
+	{
+		dtNode* node = &m_nodes[m_slots[slot].idx];
+		if (m_slots[slot].id == id && node->state == state)
+			return node;
+	}
+	return 0;
+}
+
+dtNode* dtStampedNodePool::getNode(dtPolyRef id, unsigned char state)
+{
+	const unsigned int mask = (unsigned int)m_hashSize - 1;
+	unsigned int slot = dtHashRef(id) & mask;
+	for (; m_slots[slot].stamp == m_stamp; slot = (slot+1) & mask)
+	{
+		dtNode* node = &m_nodes[m_slots[slot].idx];
+		if (m_slots[slot].id == id && node->state == state)
+			return node;
+	}
+
+	if (m_nodeCount >= m_maxNodes)
+		return 0;
+
+	// slot is the empty slot that ended the probe. The table is at least
+	// twice the pool size, so there always is one.
+	dtNodeIndex i = (dtNodeIndex)m_nodeCount;
+	m_nodeCount++;
+
+	// Init node
+	dtNode* node = &m_nodes[i];
+	node->pidx = 0;
+	node->cost = 0;
+	node->total = 0;
+	node->id = id;
+	node->state = state;
+	node->flags = 0;
+
+	m_slots[slot].id = id;
+	m_slots[slot].stamp = m_stamp;
+	m_slots[slot].idx = i;
+
+	return node;
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 dtNodeQueue::dtNodeQueue(int n) :
 	m_heap(0),
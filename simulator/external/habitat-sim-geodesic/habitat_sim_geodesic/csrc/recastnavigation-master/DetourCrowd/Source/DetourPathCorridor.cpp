@@ -447,7 +447,7 @@ bool dtPathCorridor::movePosition(const float* npos, dtNavMeshQuery* navquery, c
 	dtPolyRef visited[MAX_VISITED];
 	int nvisited = 0;
 	dtStatus status = navquery->moveAlongSurface(m_path[0], m_pos, npos, filter,
-												 result, visited, &nvisited, MAX_VISITED);
+												 result, visited, &nvisited, MAX_VISITED, true);
 	if (dtStatusSucceed(status)) {
 		m_npath = dtMergeCorridorStartMoved(m_path, m_npath, m_maxPath, visited, nvisited);
 
@@ -485,7 +485,7 @@ bool dtPathCorridor::moveTargetPosition(const float* npos, dtNavMeshQuery* navqu
 	dtPolyRef visited[MAX_VISITED];
 	int nvisited = 0;
 	dtStatus status = navquery->moveAlongSurface(m_path[m_npath-1], m_target, npos, filter,
-												 result, visited, &nvisited, MAX_VISITED);
+												 result, visited, &nvisited, MAX_VISITED, true);
 	if (dtStatusSucceed(status))
 	{
 		m_npath = dtMergeCorridorEndMoved(m_path, m_npath, m_maxPath, visited, nvisited);
@@ -0,0 +1,72 @@
+// Packs every .navmesh file under an asset directory into a single navmesh
+// bundle, which the simulator maps instead of loading each navmesh file.
+// Navmeshes are keyed by their path relative to the asset directory, without
+// the extension, the same way the simulator names scenes.
+//
+// Packing also selects landmarks for each navmesh and stores their A*
+// heuristic tables, which takes a while on large scenes.
+//
+// Each navmesh's file size and modification time are stored too. Navmesh
+// files that no longer match, because they were regenerated after packing,
+// are loaded from the file by the simulator with a warning until the bundle
+// is packed again.
+//
+// Usage: pack_navmeshes ASSET_DIR [BUNDLE]
+//
+// BUNDLE defaults to ASSET_DIR/navmeshes.bundle
+
+#include <PathFinder.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        cerr << argv[0] << " ASSET_DIR [BUNDLE]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    filesystem::path asset_dir {argv[1]};
+    filesystem::path bundle_path =
+        argc > 2 ? filesystem::path(argv[2]) : asset_dir / "navmeshes.bundle";
+
+    vector<pair<string, string>> navmeshes;
+    for (const auto &entry :
+         filesystem::recursive_directory_iterator(asset_dir)) {
+        const filesystem::path &path = entry.path();
+        if (!entry.is_regular_file() || path.extension() != ".navmesh") {
+            continue;
+        }
+
+        filesystem::path name =
+            filesystem::relative(path, asset_dir).replace_extension();
+        navmeshes.emplace_back(name.generic_string(), path.string());
+    }
+
+    if (navmeshes.empty()) {
+        cerr << "No navmeshes found in " << asset_dir << endl;
+        return EXIT_FAILURE;
+    }
+
+    // Keeps the bundle layout independent of directory iteration order
+    sort(navmeshes.begin(), navmeshes.end());
+
+    if (!esp::nav::PathFinder::packNavMeshes(navmeshes,
+                                             bundle_path.string())) {
+        cerr << "Failed to pack navmeshes into " << bundle_path << endl;
+        return EXIT_FAILURE;
+    }
+
+    cout << "Packed " << navmeshes.size() << " navmeshes into "
+         << bundle_path << endl;
+
+    return EXIT_SUCCESS;
+}
@@ -5,6 +5,12 @@
 #include <cuda.h>
 #include <cuda_runtime.h>
 
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <utility>
+#include <vector>
+
 using namespace std;
 namespace py = pybind11;
 
@@ -66,10 +72,249 @@ py::capsule tensorToCapsule(const at::Tensor &tensor)
     return py::capsule(tensor.data_ptr());
 }
 
+// The advantage kernels below take [T, N, ...] rewards and [T + 1, N, ...]
+// value predictions, masks and ratios, on any device, and walk the T steps
+// backwards once with every env in the same contiguous row, rather than
+// launching a handful of tiny tensor ops per step. Results are [T, N, ...],
+// on the device of rewards.
+
+// Flattens a [T, N, ...] tensor to a contiguous [T, N'] float tensor on the
+// CPU
+static at::Tensor toCPURows(const at::Tensor &tensor, int64_t num_rows)
+{
+    TORCH_CHECK(tensor.dim() >= 2 && tensor.size(0) == num_rows,
+                "expected ", num_rows, " steps, got a tensor of shape ",
+                tensor.sizes());
+
+    return tensor.to(at::kCPU, at::kFloat).contiguous().view({num_rows, -1});
+}
+
+// Returns of GAE(gamma, tau) bootstrapped from value_preds[T]. With tau = 1
+// these are the plain discounted returns.
+at::Tensor computeGAEReturns(const at::Tensor &rewards,
+                             const at::Tensor &value_preds,
+                             const at::Tensor &masks,
+                             double gamma,
+                             double tau)
+{
+    const int64_t num_steps = rewards.size(0);
+    at::Tensor rewards_cpu = toCPURows(rewards, num_steps);
+    at::Tensor values_cpu = toCPURows(value_preds, num_steps + 1);
+    at::Tensor masks_cpu = toCPURows(masks, num_steps + 1);
+
+    const int64_t num_envs = rewards_cpu.size(1);
+    TORCH_CHECK(values_cpu.size(1) == num_envs &&
+                    masks_cpu.size(1) == num_envs,
+                "rewards, value_preds and masks differ in number of envs");
+
+    at::Tensor returns =
+        at::empty({num_steps, num_envs}, rewards_cpu.options());
+    vector<float> gae(num_envs, 0.f);
+
+    const float *r = rewards_cpu.data_ptr<float>();
+    const float *v = values_cpu.data_ptr<float>();
+    const float *m = masks_cpu.data_ptr<float>();
+    float *ret = returns.data_ptr<float>();
+    const float g = gamma;
+    const float gt = gamma * tau;
+
+    for (int64_t t = num_steps - 1; t >= 0; t--) {
+        const float *r_t = r + t * num_envs;
+        const float *v_t = v + t * num_envs;
+        const float *v_next = v_t + num_envs;
+        const float *m_next = m + (t + 1) * num_envs;
+        float *ret_t = ret + t * num_envs;
+
+        for (int64_t n = 0; n < num_envs; n++) {
+            float delta = r_t[n] + g * v_next[n] * m_next[n] - v_t[n];
+            gae[n] = delta + gt * gae[n] * m_next[n];
+            ret_t[n] = gae[n] + v_t[n];
+        }
+    }
+
+    return returns.view(rewards.sizes()).to(rewards.device());
+}
+
+// V-trace advantages and value targets, with importance ratios clipped at
+// rho and c. Only the first T ratios are used.
+tuple<at::Tensor, at::Tensor> computeVTrace(const at::Tensor &rewards,
+                                           const at::Tensor &value_preds,
+                                           const at::Tensor &masks,
+                                           const at::Tensor &ratios,
+                                           double gamma,
+                                           double tau,
+                                           double rho,
+                                           double c)
+{
+    const int64_t num_steps = rewards.size(0);
+    at::Tensor rewards_cpu = toCPURows(rewards, num_steps);
+    at::Tensor values_cpu = toCPURows(value_preds, num_steps + 1);
+    at::Tensor masks_cpu = toCPURows(masks, num_steps + 1);
+    at::Tensor ratios_cpu = toCPURows(ratios, num_steps + 1);
+
+    const int64_t num_envs = rewards_cpu.size(1);
+    TORCH_CHECK(values_cpu.size(1) == num_envs &&
+                    masks_cpu.size(1) == num_envs &&
+                    ratios_cpu.size(1) == num_envs,
+                "rewards, value_preds, masks and ratios differ in number of "
+                "envs");
+
+    at::Tensor advantages =
+        at::empty({num_steps, num_envs}, rewards_cpu.options());
+    at::Tensor vs = at::empty({num_steps, num_envs}, rewards_cpu.options());
+
+    const float *r = rewards_cpu.data_ptr<float>();
+    const float *v = values_cpu.data_ptr<float>();
+    const float *m = masks_cpu.data_ptr<float>();
+    const float *ratio = ratios_cpu.data_ptr<float>();
+    float *adv = advantages.data_ptr<float>();
+    float *vs_out = vs.data_ptr<float>();
+    const float g = gamma;
+    const float rho_f = rho;
+    const float c_f = c;
+    const float tau_f = tau;
+
+    // vs of the following step, starting from the bootstrap value
+    vector<float> vs_next(v + num_steps * num_envs,
+                          v + (num_steps + 1) * num_envs);
+
+    for (int64_t t = num_steps - 1; t >= 0; t--) {
+        const float *r_t = r + t * num_envs;
+        const float *v_t = v + t * num_envs;
+        const float *v_next = v_t + num_envs;
+        const float *m_next = m + (t + 1) * num_envs;
+        const float *ratio_t = ratio + t * num_envs;
+        float *adv_t = adv + t * num_envs;
+        float *vs_t = vs_out + t * num_envs;
+
+        for (int64_t n = 0; n < num_envs; n++) {
+            float gamma_mask = g * m_next[n];
+            float clipped_rho = min(ratio_t[n], rho_f);
+            float clipped_c = tau_f * gamma_mask * min(ratio_t[n], c_f);
+
+            float delta =
+                clipped_rho * (r_t[n] + gamma_mask * v_next[n] - v_t[n]);
+            adv_t[n] =
+                clipped_rho * (r_t[n] + gamma_mask * vs_next[n] - v_t[n]);
+
+            vs_t[n] = v_t[n] + delta + clipped_c * (vs_next[n] - v_next[n]);
+            vs_next[n] = vs_t[n];
+        }
+    }
+
+    return {advantages.view(rewards.sizes()).to(rewards.device()),
+            vs.view(rewards.sizes()).to(rewards.device())};
+}
+
+// Gathers a minibatch of envs from rollout fields whose [T, N, ...] storage
+// is split along N across several tensors, such as the halves of a double
+// buffered rollout. For every field, out[t, j] is set to env env_inds[j]
+// of the field for the first out.size(0) steps, where envs are numbered
+// across the field's tensors in order. The outs are written in place, so
+// they can be allocated once and reused for every minibatch, and runs of
+// consecutive envs are copied together as one strided copy.
+void gatherMinibatch(const vector<vector<at::Tensor>> &sources,
+                     const at::Tensor &env_inds,
+                     const vector<at::Tensor> &outs)
+{
+    TORCH_CHECK(sources.size() == outs.size(),
+                "expected one output per field");
+
+    at::Tensor inds_cpu = env_inds.to(at::kCPU, at::kLong).contiguous();
+    const int64_t *inds = inds_cpu.data_ptr<int64_t>();
+    const int64_t num_envs = inds_cpu.numel();
+
+    // The tensor and env within it of each index, numbering envs across a
+    // field's tensors
+    vector<pair<int64_t, int64_t>> locations(num_envs);
+
+    for (size_t field = 0; field < outs.size(); field++) {
+        const vector<at::Tensor> &parts = sources[field];
+        const at::Tensor &out = outs[field];
+
+        TORCH_CHECK(out.is_contiguous() && out.dim() >= 2 &&
+                        out.size(1) == num_envs,
+                    "output ", field, " must be contiguous with ", num_envs,
+                    " envs");
+        const int64_t num_steps = out.size(0);
+        const at::IntArrayRef env_shape = out.sizes().slice(2);
+        int64_t env_bytes = out.element_size();
+        for (int64_t size : env_shape) {
+            env_bytes *= size;
+        }
+
+        vector<int64_t> first_env {0};
+        for (const at::Tensor &part : parts) {
+            TORCH_CHECK(part.is_contiguous() && part.dim() == out.dim() &&
+                            part.scalar_type() == out.scalar_type() &&
+                            part.size(0) >= num_steps &&
+                            part.sizes().slice(2) == env_shape,
+                        "field ", field, " doesn't match its output");
+            first_env.push_back(first_env.back() + part.size(1));
+        }
+
+        for (int64_t j = 0; j < num_envs; j++) {
+            TORCH_CHECK(inds[j] >= 0 && inds[j] < first_env.back(),
+                        "env index ", inds[j], " is out of range");
+            int64_t part = upper_bound(first_env.begin(), first_env.end(),
+                                       inds[j]) -
+                           first_env.begin() - 1;
+            locations[j] = {part, inds[j] - first_env[part]};
+        }
+
+        const bool on_cpu = out.is_cpu() &&
+                            all_of(parts.begin(), parts.end(),
+                                   [](const at::Tensor &t) {
+                                       return t.is_cpu();
+                                   });
+
+        char *dst_base = static_cast<char *>(out.data_ptr());
+        const int64_t dst_pitch = num_envs * env_bytes;
+
+        int64_t run_start = 0;
+        while (num_steps > 0 && run_start < num_envs) {
+            auto [part, env] = locations[run_start];
+            int64_t run_end = run_start + 1;
+            while (run_end < num_envs &&
+                   locations[run_end].first == part &&
+                   locations[run_end].second ==
+                       env + (run_end - run_start)) {
+                run_end++;
+            }
+
+            const char *src =
+                static_cast<const char *>(parts[part].data_ptr()) +
+                env * env_bytes;
+            const int64_t src_pitch = parts[part].size(1) * env_bytes;
+            char *dst = dst_base + run_start * env_bytes;
+            const int64_t width = (run_end - run_start) * env_bytes;
+
+            if (on_cpu) {
+                for (int64_t t = 0; t < num_steps; t++) {
+                    memcpy(dst + t * dst_pitch, src + t * src_pitch, width);
+                }
+            } else {
+                cudaError_t err = cudaMemcpy2DAsync(
+                    dst, dst_pitch, src, src_pitch, width, num_steps,
+                    cudaMemcpyDefault,
+                    at::cuda::getCurrentCUDAStream(
+                        out.is_cuda() ? out.get_device() :
+                                        parts[part].get_device()));
+                TORCH_CHECK(err == cudaSuccess, cudaGetErrorString(err));
+            }
+
+            run_start = run_end;
+        }
+    }
+}
+
 PYBIND11_MODULE(TORCH_EXTENSION_NAME, m)
 {
     m.def("make_color_tensor", &convertToTensorColor);
     m.def("make_depth_tensor", &convertToTensorDepth);
     m.def("make_fcout_tensor", &convertToTensorFCOut);
     m.def("tensor_to_capsule", &tensorToCapsule);
+    m.def("compute_gae_returns", &computeGAEReturns);
+    m.def("compute_vtrace", &computeVTrace);
+    m.def("gather_minibatch", &gatherMinibatch);
 }
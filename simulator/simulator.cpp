@@ -15,6 +15,7 @@
 #include <condition_variable>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <future>
 #include <memory>
 #include <optional>
@@ -23,9 +24,13 @@
 #include <string_view>
 #include <thread>
 #include <utility>
-#include <unordered_set>
+#include <unordered_map>
 #include <vector>
+#include <fcntl.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Spinning will never be beneficial, always takes some time to come back
 // around for the next iteration
@@ -43,6 +48,39 @@ using namespace std;
 using namespace bps3D;
 namespace py = pybind11;
 
+// Build options, set from CMake
+#ifndef BPS_SIM_GOAL_DISTANCE_FIELD
+#define BPS_SIM_GOAL_DISTANCE_FIELD 0
+#endif
+
+#ifndef BPS_SIM_GOAL_CORRIDOR
+#define BPS_SIM_GOAL_CORRIDOR 0
+#endif
+
+#ifndef BPS_SIM_START_DISTANCE_FIELD
+#define BPS_SIM_START_DISTANCE_FIELD 0
+#endif
+
+#ifndef BPS_SIM_WORK_STEALING
+#define BPS_SIM_WORK_STEALING 0
+#endif
+
+#ifndef BPS_SIM_RESET_AHEAD
+#define BPS_SIM_RESET_AHEAD 0
+#endif
+
+#ifndef BPS_SIM_SPECULATE_FORWARD
+#define BPS_SIM_SPECULATE_FORWARD 0
+#endif
+
+#ifndef BPS_SIM_PROFILE
+#define BPS_SIM_PROFILE 0
+#endif
+
+#ifndef BPS_SIM_RECORD_TRACE
+#define BPS_SIM_RECORD_TRACE 0
+#endif
+
 namespace SimulatorConfig {
 constexpr float SUCCESS_REWARD = 2.5;
 constexpr float SLACK_REWARD = 1e-2;
@@ -58,6 +96,47 @@ constexpr glm::vec3 CAM_FWD_VECTOR =
 static const glm::quat LEFT_ROTATION = glm::angleAxis(TURN_ANGLE, UP_VECTOR);
 
 static const glm::quat RIGHT_ROTATION = glm::angleAxis(-TURN_ANGLE, UP_VECTOR);
+
+// Build a geodesic distance field from the goal on reset, so the per step
+// distance to goal is a lookup rather than an A* search. The field follows
+// its own chain of polys to each poly rather than findPath's corridor, so
+// where several corridors lead to the goal the two distances can differ by
+// a few percent, though neither is shorter than the geodesic
+constexpr bool GOAL_DISTANCE_FIELD = BPS_SIM_GOAL_DISTANCE_FIELD;
+// Without the field, keep the path to the goal between steps and patch it as
+// the agent moves, so only leaving the path costs an A* search
+constexpr bool GOAL_CORRIDOR = BPS_SIM_GOAL_CORRIDOR;
+// Likewise for Flee, build the field from the start position on reset.
+// Distances from start differ from computeGeoDist's the same way
+constexpr bool START_DISTANCE_FIELD = BPS_SIM_START_DISTANCE_FIELD;
+
+// Give each simulation thread its own range of envs per step (expensive envs
+// first) and let threads steal from each other's ranges, rather than having
+// all threads claim envs one by one from a single shared counter
+constexpr bool WORK_STEALING = BPS_SIM_WORK_STEALING;
+// With work stealing, threads claim 1 / OWNER_CHUNK_DIVISOR of the cheap
+// envs left in their own range at a time, and steal 1 / STEAL_CHUNK_DIVISOR
+// of what is left in another thread's range
+constexpr uint32_t OWNER_CHUNK_DIVISOR = 4;
+constexpr uint32_t STEAL_CHUNK_DIVISOR = 2;
+
+// Have worker threads prepare each env's next episode (episode choice,
+// snapping and initial distances) while they would otherwise be waiting on
+// policy inference, so resets inside a step don't run navmesh queries
+constexpr bool RESET_AHEAD = BPS_SIM_RESET_AHEAD;
+
+// Have worker threads compute where MoveForward would take each env, and
+// the resulting distances, while waiting on policy inference. The policy
+// picks MoveForward most of the time, so most steps become a lookup.
+constexpr bool SPECULATE_FORWARD = BPS_SIM_SPECULATE_FORWARD;
+
+// Time the phases of each step on every simulation thread, see
+// PhaseProfiler
+constexpr bool PROFILE = BPS_SIM_PROFILE;
+
+// Record the episodes envs play as pathfinder_bench query traces, see
+// QueryTraceRecorder
+constexpr bool RECORD_TRACE = BPS_SIM_RECORD_TRACE;
 }
 
 template <typename T>
@@ -89,10 +168,121 @@ struct Episode {
 struct SceneMetadata {
     uint32_t firstEpisode;
     uint32_t numEpisodes;
+    string sceneName;
     string meshPath;
     string navPath;
 };
 
+static SceneMetadata makeSceneMetadata(uint32_t first_episode,
+                                       uint32_t num_episodes,
+                                       string_view scene_name,
+                                       const string &asset_path_name)
+{
+    // FIXME is there some more principled way to get the navmesh path?
+    return SceneMetadata {
+        first_episode,
+        num_episodes,
+        string(scene_name),
+        asset_path_name + "/" + string(scene_name) + ".bps",
+        asset_path_name + "/" + string(scene_name) + ".navmesh",
+    };
+}
+
+// Binary copy of a parsed dataset, written next to the json files the first
+// time they are loaded. Later runs mmap it and use the episodes in place
+// instead of decompressing and parsing every file again.
+namespace EpisodeCache {
+constexpr uint32_t MAGIC = 0x43455342;  // 'BSEC'
+constexpr uint32_t VERSION = 2;
+constexpr const char *FILE_NAME = "episodes.bpscache";
+constexpr uint64_t SECTION_ALIGNMENT = 64;
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    // Hash of the names, sizes and mtimes of the source files, a mismatch
+    // means the cache is stale
+    uint64_t sourceKey;
+    // sizeof(Episode) when written, so a changed Episode layout is never
+    // read as a valid cache
+    uint64_t episodeSize;
+    uint64_t numEpisodes;
+    uint64_t numScenes;
+    uint64_t episodesOffset;
+    uint64_t scenesOffset;
+    uint64_t stringsOffset;
+    uint64_t totalSize;
+};
+
+struct SceneEntry {
+    uint32_t firstEpisode;
+    uint32_t numEpisodes;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+
+static_assert(is_trivially_copyable_v<Episode>);
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t num_bytes)
+{
+    // FNV-1a
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < num_bytes; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+}
+
+// Whether every section and scene of a num_bytes cache lies within the
+// file, so a corrupt or hand edited cache can't make the loader read past
+// the mapping
+static bool validLayout(const char *base, uint64_t num_bytes)
+{
+    const Header &header = *reinterpret_cast<const Header *>(base);
+
+    if (header.episodeSize != sizeof(Episode) ||
+        header.totalSize != num_bytes ||
+        header.episodesOffset < sizeof(Header) ||
+        header.episodesOffset % alignof(Episode) != 0 ||
+        header.scenesOffset % alignof(SceneEntry) != 0 ||
+        header.scenesOffset < header.episodesOffset ||
+        header.stringsOffset < header.scenesOffset ||
+        header.stringsOffset > num_bytes) {
+        return false;
+    }
+
+    const uint64_t max_episodes =
+        (header.scenesOffset - header.episodesOffset) / sizeof(Episode);
+    const uint64_t max_scenes =
+        (header.stringsOffset - header.scenesOffset) / sizeof(SceneEntry);
+    if (header.numEpisodes > max_episodes || header.numScenes > max_scenes) {
+        return false;
+    }
+
+    const auto *scenes =
+        reinterpret_cast<const SceneEntry *>(base + header.scenesOffset);
+    const uint64_t strings_size = num_bytes - header.stringsOffset;
+
+    for (uint64_t i = 0; i < header.numScenes; i++) {
+        const SceneEntry &scene = scenes[i];
+        if (scene.firstEpisode > header.numEpisodes ||
+            scene.numEpisodes > header.numEpisodes - scene.firstEpisode ||
+            scene.nameOffset > strings_size ||
+            scene.nameLength > strings_size - scene.nameOffset) {
+            return false;
+        }
+    }
+
+    return true;
+}
+}
+
 template <typename T>
 class DynArray {
 public:
@@ -193,16 +383,21 @@ public:
             const string &asset_path_name,
             uint32_t num_threads)
         : episodes_(),
-          scenes_()
+          scenes_(),
+          episode_data_(nullptr),
+          cache_mapping_(nullptr),
+          cache_size_(0)
     {
         filesystem::path dataset_name {dataset_path_name};
         constexpr const char *data_suffix = ".json.gz";
 
         vector<pair<string, size_t>> json_files;
+        uint64_t source_key = 0xcbf29ce484222325ull;
         for (const auto &entry :
              filesystem::directory_iterator(dataset_name)) {
             const string filename = entry.path().string();
-            if (string_view(filename).substr(
+            if (filename.size() >= strlen(data_suffix) &&
+                string_view(filename).substr(
                     filename.size() - strlen(data_suffix)) == data_suffix) {
                 json_files.push_back({
                     filename,
@@ -211,6 +406,27 @@ public:
             }
         }
 
+        sort(json_files.begin(), json_files.end());
+
+        for (const auto &[file_name, num_bytes] : json_files) {
+            int64_t mtime = filesystem::last_write_time(file_name)
+                                .time_since_epoch()
+                                .count();
+
+            source_key = EpisodeCache::hashBytes(source_key, file_name.data(),
+                                                 file_name.size());
+            source_key = EpisodeCache::hashBytes(source_key, &num_bytes,
+                                                 sizeof(num_bytes));
+            source_key =
+                EpisodeCache::hashBytes(source_key, &mtime, sizeof(mtime));
+        }
+
+        const filesystem::path cache_path =
+            dataset_name / EpisodeCache::FILE_NAME;
+        if (mapCache(cache_path, source_key, asset_path_name)) {
+            return;
+        }
+
         num_threads =
             min(num_threads, static_cast<uint32_t>(json_files.size()));
 
@@ -295,20 +511,11 @@ public:
                             abort();
                         }
 
-                        string bps_suffix =
-                            string(scene_id.substr(0, dotpos)) + ".bps";
-
-                        // FIXME is there some more principled way to get this?
-                        string navmesh_suffix =
-                            string(scene_id.substr(0, dotpos)) + ".navmesh";
-
-                        scenes.push_back({
+                        scenes.push_back(makeSceneMetadata(
                             scene_episode_start,
                             static_cast<uint32_t>(episodes.size() -
                                                   scene_episode_start),
-                            asset_path_name + "/" + bps_suffix,
-                            asset_path_name + "/" + navmesh_suffix,
-                        });
+                            scene_id.substr(0, dotpos), asset_path_name));
                     }
                 }
 
@@ -333,12 +540,26 @@ public:
         for (uint32_t i = 0; i < num_threads; i++) {
             loader_threads[i].join();
         }
+
+        episode_data_ = episodes_.data();
+
+        writeCache(cache_path, source_key);
+    }
+
+    Dataset(const Dataset &) = delete;
+    Dataset &operator=(const Dataset &) = delete;
+
+    ~Dataset()
+    {
+        if (cache_mapping_ != nullptr) {
+            munmap(cache_mapping_, cache_size_);
+        }
     }
 
     Span<const Episode> getEpisodes(uint32_t scene_idx) const
     {
         const SceneMetadata &scene = scenes_[scene_idx];
-        return Span(&episodes_[scene.firstEpisode], scene.numEpisodes);
+        return Span(episode_data_ + scene.firstEpisode, scene.numEpisodes);
     }
 
     const string_view getScenePath(uint32_t scene_idx) const
@@ -351,20 +572,163 @@ public:
         return scenes_[scene_idx].navPath;
     }
 
+    const string_view getSceneName(uint32_t scene_idx) const
+    {
+        return scenes_[scene_idx].sceneName;
+    }
+
     uint32_t numScenes() const { return scenes_.size(); }
 
 private:
+    bool mapCache(const filesystem::path &cache_path,
+                  uint64_t source_key,
+                  const string &asset_path_name)
+    {
+        int fd = open(cache_path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return false;
+        }
+
+        struct stat cache_stat;
+        if (fstat(fd, &cache_stat) != 0 ||
+            size_t(cache_stat.st_size) < sizeof(EpisodeCache::Header)) {
+            close(fd);
+            return false;
+        }
+
+        size_t num_bytes = cache_stat.st_size;
+        void *mapping =
+            mmap(nullptr, num_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+
+        const char *base = static_cast<const char *>(mapping);
+        const auto &header =
+            *reinterpret_cast<const EpisodeCache::Header *>(base);
+
+        // Anything else falls back to parsing the json, which rewrites the
+        // cache
+        if (header.magic != EpisodeCache::MAGIC ||
+            header.version != EpisodeCache::VERSION ||
+            header.sourceKey != source_key ||
+            !EpisodeCache::validLayout(base, num_bytes)) {
+            munmap(mapping, num_bytes);
+            return false;
+        }
+
+        cache_mapping_ = mapping;
+        cache_size_ = num_bytes;
+
+        episode_data_ =
+            reinterpret_cast<const Episode *>(base + header.episodesOffset);
+
+        const auto *scenes =
+            reinterpret_cast<const EpisodeCache::SceneEntry *>(
+                base + header.scenesOffset);
+        const char *strings = base + header.stringsOffset;
+
+        scenes_.reserve(header.numScenes);
+        for (uint64_t i = 0; i < header.numScenes; i++) {
+            const EpisodeCache::SceneEntry &scene = scenes[i];
+            scenes_.push_back(makeSceneMetadata(
+                scene.firstEpisode, scene.numEpisodes,
+                string_view(strings + scene.nameOffset, scene.nameLength),
+                asset_path_name));
+        }
+
+        return true;
+    }
+
+    // Failing to write the cache isn't an error (the dataset directory may
+    // be read-only), the next run will just parse the json again.
+    void writeCache(const filesystem::path &cache_path,
+                    uint64_t source_key) const
+    {
+        vector<EpisodeCache::SceneEntry> scenes;
+        scenes.reserve(scenes_.size());
+        string strings;
+        for (const SceneMetadata &scene : scenes_) {
+            scenes.push_back({
+                scene.firstEpisode,
+                scene.numEpisodes,
+                static_cast<uint32_t>(strings.size()),
+                static_cast<uint32_t>(scene.sceneName.size()),
+            });
+            strings += scene.sceneName;
+        }
+
+        EpisodeCache::Header header;
+        header.magic = EpisodeCache::MAGIC;
+        header.version = EpisodeCache::VERSION;
+        header.sourceKey = source_key;
+        header.episodeSize = sizeof(Episode);
+        header.numEpisodes = episodes_.size();
+        header.numScenes = scenes.size();
+        header.episodesOffset =
+            EpisodeCache::alignOffset(sizeof(EpisodeCache::Header));
+        header.scenesOffset = EpisodeCache::alignOffset(
+            header.episodesOffset + sizeof(Episode) * episodes_.size());
+        header.stringsOffset = EpisodeCache::alignOffset(
+            header.scenesOffset +
+            sizeof(EpisodeCache::SceneEntry) * scenes.size());
+        header.totalSize = header.stringsOffset + strings.size();
+
+        // Write to a private file and rename it into place, so concurrently
+        // starting jobs never see a partially written cache
+        filesystem::path tmp_path = cache_path;
+        tmp_path += ".tmp." + to_string(getpid());
+
+        {
+            ofstream out(tmp_path, ios::binary);
+
+            auto writeAt = [&out](uint64_t offset, const void *data,
+                                  size_t num_bytes) {
+                out.seekp(offset);
+                out.write(static_cast<const char *>(data), num_bytes);
+            };
+
+            writeAt(0, &header, sizeof(EpisodeCache::Header));
+            writeAt(header.episodesOffset, episodes_.data(),
+                    sizeof(Episode) * episodes_.size());
+            writeAt(header.scenesOffset, scenes.data(),
+                    sizeof(EpisodeCache::SceneEntry) * scenes.size());
+            writeAt(header.stringsOffset, strings.data(), strings.size());
+
+            if (!out) {
+                cerr << "Failed to write episode cache " << tmp_path << endl;
+                out.close();
+                error_code ec;
+                filesystem::remove(tmp_path, ec);
+                return;
+            }
+        }
+
+        error_code ec;
+        filesystem::rename(tmp_path, cache_path, ec);
+        if (ec) {
+            filesystem::remove(tmp_path, ec);
+        }
+    }
+
     vector<Episode> episodes_;
     vector<SceneMetadata> scenes_;
+
+    // Either episodes_.data() or a pointer into the mmapped cache
+    const Episode *episode_data_;
+    void *cache_mapping_;
+    size_t cache_size_;
 };
 
-Renderer makeRenderer(int32_t gpu_id,
-                      uint32_t renderer_batch_size,
-                      uint32_t num_loaders,
-                      const array<uint32_t, 2> &resolution,
-                      bool color,
-                      bool depth,
-                      bool double_buffered)
+RenderConfig makeRenderConfig(int32_t gpu_id,
+                              uint32_t renderer_batch_size,
+                              uint32_t num_loaders,
+                              const array<uint32_t, 2> &resolution,
+                              bool color,
+                              bool depth,
+                              bool double_buffered)
 {
     RenderMode mode {};
     if (color) {
@@ -385,7 +749,7 @@ Renderer makeRenderer(int32_t gpu_id,
         mode,
     };
 
-    return Renderer(cfg);
+    return cfg;
 }
 
 template <typename T>
@@ -550,23 +914,657 @@ private:
     thread loader_thread_;
 };
 
-static inline float computeGeoDist(esp::nav::ShortestPath &test_path,
-                                   const esp::nav::NavMeshPoint &start,
+// Keeps the navmeshes of the scenes in use loaded, and only those. A scene's
+// navmesh is loaded in the background when a SceneSwapper picks it and
+// unloaded once the last env has moved off it, so the memory used stays
+// bounded by the number of active scenes rather than the dataset size.
+//
+// Each navmesh is loaded exactly once and then shared (read-only) by the
+// per-thread PathFinders, which follow along in syncPathfinders. Apart from
+// the background loads, everything here runs on the main thread between
+// simulation steps.
+class NavmeshResidency {
+public:
+    NavmeshResidency(const Dataset &dataset, const string &asset_path)
+        : dataset_(dataset),
+          bundle_(openBundle(asset_path)),
+          bundle_indices_(findBundleEntries(dataset, bundle_.get())),
+          pathfinders_(dataset.numScenes()),
+          ref_counts_(dataset.numScenes()),
+          resident_(dataset.numScenes()),
+          epoch_(1),
+          loader_mutex_(),
+          loader_cv_(),
+          loader_exit_(false),
+          loader_requests_(),
+          loader_thread_([this]() { loaderLoop(); })
+    {}
+
+    ~NavmeshResidency()
+    {
+        {
+            lock_guard<mutex> cv_lock(loader_mutex_);
+            loader_exit_ = true;
+        }
+        loader_cv_.notify_one();
+        loader_thread_.join();
+    }
+
+    NavmeshResidency(const NavmeshResidency &) = delete;
+
+    // Loads the initial scenes up front, spread over num_threads threads
+    void loadScenes(const vector<uint32_t> &scene_indices,
+                    uint32_t num_threads)
+    {
+        num_threads =
+            max(min<uint32_t>(num_threads, scene_indices.size()), 1u);
+
+        atomic_uint32_t next_scene(0);
+        vector<thread> loader_threads;
+        loader_threads.reserve(num_threads);
+
+        for (uint32_t i = 0; i < num_threads; i++) {
+            loader_threads.emplace_back([&]() {
+                uint32_t idx;
+                while ((idx = next_scene.fetch_add(
+                            1, memory_order_relaxed)) < scene_indices.size()) {
+                    loadNavmesh(scene_indices[idx]);
+                }
+            });
+        }
+
+        for (auto &t : loader_threads) {
+            t.join();
+        }
+
+        for (uint32_t scene_idx : scene_indices) {
+            ref_counts_[scene_idx]++;
+            publish(scene_idx);
+        }
+    }
+
+    // Starts loading scene_idx if it isn't loaded already. Once the future
+    // is ready, publish makes the navmesh visible to the simulation threads.
+    FastFuture<bool> acquire(uint32_t scene_idx)
+    {
+        FastFuture<bool> loaded;
+
+        if (ref_counts_[scene_idx]++ > 0) {
+            loaded.promise().set_result(true);
+        } else {
+            {
+                lock_guard<mutex> wait_lock(loader_mutex_);
+                loader_requests_.emplace(scene_idx, loaded.promise());
+            }
+            loader_cv_.notify_one();
+        }
+
+        return loaded;
+    }
+
+    void publish(uint32_t scene_idx)
+    {
+        if (!resident_[scene_idx]) {
+            resident_[scene_idx] = true;
+            epoch_++;
+        }
+    }
+
+    void release(uint32_t scene_idx)
+    {
+        if (--ref_counts_[scene_idx] == 0) {
+            resident_[scene_idx] = false;
+            pathfinders_[scene_idx].releaseNavMesh();
+            epoch_++;
+        }
+    }
+
+    // Shares the resident navmeshes with a thread's PathFinders and drops
+    // the ones that were unloaded. Must be called at the start of a
+    // simulation step, epoch is the thread's record of the last sync.
+    void syncPathfinders(vector<esp::nav::PathFinder> &pathfinders,
+                         uint64_t &epoch) const
+    {
+        if (epoch == epoch_) {
+            return;
+        }
+
+        for (uint32_t scene_idx = 0; scene_idx < pathfinders.size();
+             scene_idx++) {
+            esp::nav::PathFinder &pathfinder = pathfinders[scene_idx];
+            if (resident_[scene_idx] == pathfinder.isLoaded()) {
+                continue;
+            }
+
+            if (resident_[scene_idx]) {
+                pathfinder.shareNavMesh(pathfinders_[scene_idx]);
+            } else {
+                pathfinder.releaseNavMesh();
+            }
+        }
+
+        epoch = epoch_;
+    }
+
+private:
+    // Navmeshes packed by pack_navmeshes are mapped from the bundle rather
+    // than loaded file by file, see findBundleEntries for when scenes fall
+    // back to files
+    static shared_ptr<const esp::nav::NavMeshBundle> openBundle(
+        const string &asset_path)
+    {
+        string bundle_path = asset_path + "/navmeshes.bundle";
+        if (!filesystem::exists(bundle_path)) {
+            return nullptr;
+        }
+
+        auto bundle = esp::nav::NavMeshBundle::open(bundle_path);
+        if (!bundle) {
+            cerr << "Failed to open navmesh bundle (malformed or from an "
+                    "older pack_navmeshes): "
+                 << bundle_path << endl;
+            abort();
+        }
+
+        return bundle;
+    }
+
+    // Each scene's entry in the bundle, -1 for scenes loaded from their
+    // .navmesh file instead. Those are the scenes missing from the bundle
+    // and the ones whose .navmesh file was rebuilt or replaced after packing,
+    // which would otherwise keep using the stale packed copy.
+    static vector<int> findBundleEntries(
+        const Dataset &dataset, const esp::nav::NavMeshBundle *bundle)
+    {
+        vector<int> entries(dataset.numScenes(), -1);
+        if (!bundle) {
+            return entries;
+        }
+
+        uint32_t num_stale = 0;
+        for (uint32_t scene_idx = 0; scene_idx < entries.size(); scene_idx++) {
+            int entry = bundle->find(string(dataset.getSceneName(scene_idx)));
+            if (entry == -1) {
+                continue;
+            }
+
+            // Bundles may ship without the .navmesh files, leaving nothing
+            // to compare against
+            string navmesh_path(dataset.getNavmeshPath(scene_idx));
+            if (!filesystem::exists(navmesh_path) ||
+                bundle->isCurrent(entry, navmesh_path)) {
+                entries[scene_idx] = entry;
+            } else if (num_stale++ < 10) {
+                cerr << "Navmesh changed since it was packed, loading it "
+                        "instead of the bundle's copy: "
+                     << navmesh_path << endl;
+            }
+        }
+
+        if (num_stale > 0) {
+            cerr << num_stale << " navmeshes changed since they were packed, "
+                 << "rerun pack_navmeshes to update the bundle" << endl;
+        }
+
+        return entries;
+    }
+
+    void loadNavmesh(uint32_t scene_idx)
+    {
+        auto navmesh_path = dataset_.getNavmeshPath(scene_idx);
+        int bundle_idx = bundle_indices_[scene_idx];
+
+        bool navmesh_success =
+            bundle_idx != -1
+                ? pathfinders_[scene_idx].loadNavMesh(bundle_, bundle_idx)
+                : pathfinders_[scene_idx].loadNavMesh(string(navmesh_path));
+
+        if (!navmesh_success) {
+            cerr << "Failed to load navmesh: " << navmesh_path << endl;
+            abort();
+        }
+    }
+
+    void loaderLoop()
+    {
+        nice(19);
+
+        while (true) {
+            uint32_t scene_idx;
+            FastPromise<bool> loader_promise;
+            {
+                unique_lock<mutex> wait_lock(loader_mutex_);
+                while (loader_requests_.size() == 0) {
+                    if (loader_exit_) {
+                        return;
+                    }
+
+                    loader_cv_.wait(wait_lock);
+                }
+
+                scene_idx = loader_requests_.front().first;
+                loader_promise = move(loader_requests_.front().second);
+                loader_requests_.pop();
+            }
+
+            loadNavmesh(scene_idx);
+            loader_promise.set_result(true);
+        }
+    }
+
+    const Dataset &dataset_;
+    shared_ptr<const esp::nav::NavMeshBundle> bundle_;
+    vector<int> bundle_indices_;
+    vector<esp::nav::PathFinder> pathfinders_;
+    vector<uint32_t> ref_counts_;
+    vector<uint8_t> resident_;
+    uint64_t epoch_;
+
+    mutex loader_mutex_;
+    condition_variable loader_cv_;
+    bool loader_exit_;
+    queue<pair<uint32_t, FastPromise<bool>>> loader_requests_;
+    thread loader_thread_;
+};
+
+static inline float computeGeoDist(const esp::nav::NavMeshPoint &start,
                                    const esp::nav::NavMeshPoint &end,
-                                   esp::nav::PathFinder &pathfinder)
+                                   const esp::nav::PathFinder &pathfinder)
 {
-    test_path.requestedStart = start;
-    test_path.requestedEnd = end;
-
-    pathfinder.findPath(test_path);
-    return test_path.geodesicDistance;
+    return pathfinder.geodesicDistance(start, end);
 }
 
+// Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2,
+// 3"), a counter-based generator. Each block of four outputs is a keyed
+// hash of the block's counter, so there is no state to carry from one draw
+// to the next: any (seed, stream) pair gives the same numbers whichever
+// thread draws them, and creating a generator costs nothing.
+class Philox4x32 {
+public:
+    using result_type = uint32_t;
+
+    Philox4x32(uint64_t seed, uint64_t stream)
+        : key_ {uint32_t(seed), uint32_t(seed >> 32)},
+          counter_ {0, 0, uint32_t(stream), uint32_t(stream >> 32)},
+          block_(),
+          next_(block_.size())
+    {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    result_type operator()()
+    {
+        if (next_ == block_.size()) {
+            block_ = generateBlock(counter_, key_);
+            next_ = 0;
+
+            // The low two words count blocks within the stream
+            if (++counter_[0] == 0) {
+                counter_[1]++;
+            }
+        }
+
+        return block_[next_++];
+    }
+
+private:
+    static array<uint32_t, 4> generateBlock(array<uint32_t, 4> ctr,
+                                            array<uint32_t, 2> key)
+    {
+        constexpr uint32_t M0 = 0xD2511F53;
+        constexpr uint32_t M1 = 0xCD9E8D57;
+        constexpr uint32_t W0 = 0x9E3779B9;
+        constexpr uint32_t W1 = 0xBB67AE85;
+
+        for (int round = 0; round < 10; round++) {
+            uint64_t prod0 = uint64_t(M0) * ctr[0];
+            uint64_t prod1 = uint64_t(M1) * ctr[2];
+            ctr = {uint32_t(prod1 >> 32) ^ ctr[1] ^ key[0], uint32_t(prod1),
+                   uint32_t(prod0 >> 32) ^ ctr[3] ^ key[1], uint32_t(prod0)};
+            key[0] += W0;
+            key[1] += W1;
+        }
+
+        return ctr;
+    }
+
+    array<uint32_t, 2> key_;
+    array<uint32_t, 4> counter_;
+    array<uint32_t, 4> block_;
+    uint32_t next_;
+};
+
+// Phases of a step the profiler times. Phases nest, so a phase's time
+// includes that of any phases inside it.
+enum class Phase : uint32_t {
+    Simulate,
+    Step,
+    Reset,
+    TryStep,
+    Geodesic,
+    SwapScene,
+    SpeculateForward,
+    PrepareResets,
+    WorkerWait,
+    MainSpin,
+    NumPhases,
+};
+
+static constexpr array<const char *, size_t(Phase::NumPhases)> PHASE_NAMES {
+    "simulate",      "step",       "reset",    "tryStep",
+    "geodesic",      "swapScene",  "speculateForward",
+    "prepareResets", "workerWait", "mainSpin",
+};
+
+// Per thread rings of the most recent timestamped phase events, plus running
+// totals and log2 histograms of each phase's durations. A thread records
+// into the log it attached to, threads that never attached record nothing.
+// Each log has its own lock, which only contends while being read.
+class PhaseProfiler {
+public:
+    static constexpr uint32_t RING_SIZE = 1 << 16;
+    // Bucket b counts durations in [2^b, 2^(b + 1)) ns, and the last bucket
+    // everything longer
+    static constexpr uint32_t NUM_BUCKETS = 32;
+
+    struct PhaseStats {
+        uint64_t count;
+        uint64_t totalNs;
+        uint64_t maxNs;
+        array<uint64_t, NUM_BUCKETS> buckets;
+    };
+
+    using ThreadStats = array<PhaseStats, size_t(Phase::NumPhases)>;
+
+    explicit PhaseProfiler(uint32_t num_threads)
+        : num_threads_(num_threads),
+          logs_(make_unique<ThreadLog[]>(num_threads)),
+          epoch_ns_(now())
+    {}
+
+    ~PhaseProfiler()
+    {
+        if (cur_log_ >= logs_.get() && cur_log_ < logs_.get() + num_threads_) {
+            cur_log_ = nullptr;
+        }
+    }
+
+    // Has the calling thread record into log thread_idx from now on
+    void attachThread(uint32_t thread_idx)
+    {
+        if (thread_idx < num_threads_) {
+            cur_log_ = &logs_[thread_idx];
+        }
+    }
+
+    static uint64_t now()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(
+                   chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static void record(Phase phase, uint64_t start_ns, uint64_t end_ns)
+    {
+        ThreadLog *log = cur_log_;
+        if (log == nullptr) {
+            return;
+        }
+
+        const uint64_t duration_ns = end_ns - start_ns;
+
+        lock_guard<mutex> lock(log->lock);
+        log->events[log->numEvents % RING_SIZE] = {start_ns, duration_ns,
+                                                   phase};
+        log->numEvents++;
+
+        PhaseStats &stats = log->stats[size_t(phase)];
+        stats.count++;
+        stats.totalNs += duration_ns;
+        stats.maxNs = max(stats.maxNs, duration_ns);
+        stats.buckets[bucketOf(duration_ns)]++;
+    }
+
+    void clear()
+    {
+        for (uint32_t i = 0; i < num_threads_; i++) {
+            lock_guard<mutex> lock(logs_[i].lock);
+            logs_[i].numEvents = 0;
+            logs_[i].stats = {};
+        }
+    }
+
+    vector<ThreadStats> threadStats() const
+    {
+        vector<ThreadStats> stats(num_threads_);
+        for (uint32_t i = 0; i < num_threads_; i++) {
+            lock_guard<mutex> lock(logs_[i].lock);
+            stats[i] = logs_[i].stats;
+        }
+
+        return stats;
+    }
+
+    // Writes the events still in the rings as a Chrome trace (viewable in
+    // chrome://tracing or Perfetto), one track per thread with the main
+    // thread last. Returns false if path can't be written.
+    bool writeChromeTrace(const string &path) const
+    {
+        ofstream out(path);
+        if (!out) {
+            return false;
+        }
+
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        out << fixed << setprecision(3);
+
+        bool first = true;
+        auto separator = [&]() -> const char * {
+            const char *sep = first ? "\n" : ",\n";
+            first = false;
+            return sep;
+        };
+
+        for (uint32_t i = 0; i < num_threads_; i++) {
+            out << separator()
+                << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                << "\"tid\":" << i << ",\"args\":{\"name\":\""
+                << (i + 1 == num_threads_ ? "main" : "worker ")
+                << (i + 1 == num_threads_ ? "" : to_string(i)) << "\"}}";
+        }
+
+        for (uint32_t i = 0; i < num_threads_; i++) {
+            lock_guard<mutex> lock(logs_[i].lock);
+            const ThreadLog &log = logs_[i];
+
+            uint64_t first_event =
+                log.numEvents > RING_SIZE ? log.numEvents - RING_SIZE : 0;
+            for (uint64_t e = first_event; e < log.numEvents; e++) {
+                const Event &event = log.events[e % RING_SIZE];
+                out << separator() << "{\"name\":\""
+                    << PHASE_NAMES[size_t(event.phase)]
+                    << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << i
+                    << ",\"ts\":"
+                    << double(int64_t(event.startNs - epoch_ns_)) / 1000.0
+                    << ",\"dur\":" << double(event.durationNs) / 1000.0
+                    << "}";
+            }
+        }
+
+        out << "\n]}\n";
+
+        return bool(out);
+    }
+
+private:
+    struct Event {
+        uint64_t startNs;
+        uint64_t durationNs;
+        Phase phase;
+    };
+
+    struct alignas(64) ThreadLog {
+        mutable mutex lock;
+        unique_ptr<Event[]> events = make_unique<Event[]>(RING_SIZE);
+        uint64_t numEvents = 0;
+        ThreadStats stats {};
+    };
+
+    static uint32_t bucketOf(uint64_t ns)
+    {
+        return ns == 0 ? 0 :
+                         min<uint32_t>(63 - __builtin_clzll(ns),
+                                       NUM_BUCKETS - 1);
+    }
+
+    static inline thread_local ThreadLog *cur_log_ = nullptr;
+
+    uint32_t num_threads_;
+    unique_ptr<ThreadLog[]> logs_;
+    uint64_t epoch_ns_;
+};
+
+// Records its own lifetime as one event of phase on the calling thread.
+// Compiles to nothing without BPS_SIM_PROFILE.
+class PhaseScope {
+public:
+    explicit PhaseScope(Phase phase)
+        : phase_(phase),
+          start_ns_(SimulatorConfig::PROFILE ? PhaseProfiler::now() : 0)
+    {}
+
+    ~PhaseScope()
+    {
+        if constexpr (SimulatorConfig::PROFILE) {
+            PhaseProfiler::record(phase_, start_ns_, PhaseProfiler::now());
+        }
+    }
+
+    PhaseScope(const PhaseScope &) = delete;
+    PhaseScope &operator=(const PhaseScope &) = delete;
+
+private:
+    Phase phase_;
+    uint64_t start_ns_;
+};
+
+// Matches pathfinder_bench's query trace format
+constexpr uint32_t QUERY_TRACE_MAGIC = 'P' << 24 | 'F' << 16 | 'T' << 8 | 'R';
+constexpr uint32_t QUERY_TRACE_VERSION = 1;
+
+struct QueryTraceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numEpisodes;
+    uint32_t reserved;
+};
+
+// Followed in the trace by numActions one byte SimActions
+struct QueryTraceEpisode {
+    uint64_t startPoly;
+    uint64_t goalPoly;
+    float requestedStart[3];
+    float requestedGoal[3];
+    float start[3];
+    float goal[3];
+    float end[3];
+    float startYaw;
+    uint32_t numActions;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(QueryTraceEpisode) == 88);
+
+struct RecordedEpisode {
+    QueryTraceEpisode header;
+    vector<uint8_t> actions;
+};
+
+// Collects the episodes envs finish, per scene, to write them out as query
+// traces that pathfinder_bench replays against the scene's navmesh. That way
+// navmesh and PathFinder changes are benchmarked on the queries of the
+// actual policy. Episodes finish rarely enough that a single lock does.
+class QueryTraceRecorder {
+public:
+    // Bounds the memory used over long runs, later episodes of a scene are
+    // dropped
+    static constexpr uint32_t MAX_EPISODES_PER_SCENE = 10000;
+
+    void add(uint32_t scene_idx, const RecordedEpisode &episode)
+    {
+        lock_guard<mutex> lock(lock_);
+        vector<RecordedEpisode> &episodes = scenes_[scene_idx];
+        if (episodes.size() < MAX_EPISODES_PER_SCENE) {
+            episodes.push_back(episode);
+        }
+    }
+
+    void clear()
+    {
+        lock_guard<mutex> lock(lock_);
+        scenes_.clear();
+    }
+
+    // Writes DIR/SCENE_NAME.trace for every scene with recorded episodes.
+    // Returns false if any of them can't be written.
+    bool write(const string &dir, const Dataset &dataset) const
+    {
+        lock_guard<mutex> lock(lock_);
+
+        bool success = true;
+        for (const auto &[scene_idx, episodes] : scenes_) {
+            filesystem::path path =
+                filesystem::path(dir) /
+                (string(dataset.getSceneName(scene_idx)) + ".trace");
+
+            error_code err;
+            filesystem::create_directories(path.parent_path(), err);
+
+            ofstream out(path, ios::binary);
+            QueryTraceHeader header {QUERY_TRACE_MAGIC, QUERY_TRACE_VERSION,
+                                     uint32_t(episodes.size()), 0};
+            out.write(reinterpret_cast<const char *>(&header),
+                      sizeof(header));
+            for (const RecordedEpisode &episode : episodes) {
+                out.write(reinterpret_cast<const char *>(&episode.header),
+                          sizeof(episode.header));
+                out.write(
+                    reinterpret_cast<const char *>(episode.actions.data()),
+                    episode.actions.size());
+            }
+
+            success = success && bool(out);
+        }
+
+        return success;
+    }
+
+private:
+    mutable mutex lock_;
+    unordered_map<uint32_t, vector<RecordedEpisode>> scenes_;
+};
+
 template <class RewardFunctor, class InfoFunctor>
 class BaseSimulator {
 public:
     typedef typename InfoFunctor::StepInfo StepInfo;
 
+    // Everything reset needs that takes navmesh queries to compute, so it
+    // can be computed ahead of time by prepareReset
+    struct PreparedReset {
+        const Episode *episode;
+        esp::nav::NavMeshPoint navmeshStart;
+        typename InfoFunctor::PreparedReset info;
+    };
+
+    // The outcome of MoveForward from the current pose, computed ahead of
+    // time by speculateForward
+    struct Speculation {
+        esp::nav::NavMeshPoint forwardPosition;
+        typename InfoFunctor::Speculation info;
+    };
+
     struct ResultPointers {
         float *reward;
         uint8_t *mask;
@@ -574,18 +1572,26 @@ public:
         glm::vec2 *polar;
     };
 
+    // render_env is null when running without a renderer. env_id picks this
+    // env's random streams under seed, and must be unique among the envs.
     BaseSimulator(Span<const Episode> episodes,
-                  Environment &render_env,
-                  ResultPointers ptrs)
+                  Environment *render_env,
+                  ResultPointers ptrs,
+                  uint64_t seed,
+                  uint32_t env_id)
         : episodes_(episodes),
-          render_env_(&render_env),
+          render_env_(render_env),
           outputs_(ptrs),
+          seed_(seed),
+          env_id_(env_id),
+          num_resets_(0),
           episode_(),
           position_(),
           rotation_(),
           goal_(),
           navmeshPosition_(),
           step_(),
+          trace_(),
           reward_func_(new RewardFunctor()),
           info_func_(new InfoFunctor())
     {}
@@ -598,40 +1604,95 @@ public:
 
     void setEpisode(Span<const Episode> episodes) { episodes_ = episodes; }
 
-    void reset(esp::nav::PathFinder &pathfinder, mt19937 &rgen)
+    // Where the following steps and resets write their results
+    void setOutputs(ResultPointers ptrs) { outputs_ = ptrs; }
+
+    // Only reads the current episode set, so this can run on any thread
+    // that has exclusive access to prepared
+    void prepareReset(esp::nav::PathFinder &pathfinder,
+                      PreparedReset &prepared) const
     {
-        step_ = 1;
+        // Drawn from a stream for this env's next episode, rather than from
+        // a per thread generator, so the episodes each env gets don't depend
+        // on which threads prepare them or in what order
+        Philox4x32 rgen(seed_, (uint64_t(env_id_) << 32) | num_resets_);
 
         std::uniform_int_distribution<uint64_t> episode_dist(
             0, episodes_.size() - 1);
-        episode_ = &episodes_[episode_dist(rgen)];
+        prepared.episode = &episodes_[episode_dist(rgen)];
+        prepared.navmeshStart =
+            pathfinder.snapPoint(Eigen::Map<const esp::vec3f>(
+                glm::value_ptr(prepared.episode->startPosition)));
+
+        InfoFunctor::prepareReset(*prepared.episode, prepared.navmeshStart,
+                                  pathfinder, prepared.info);
+    }
+
+    // prepared may be left holding stale data, which prepareReset overwrites
+    void reset(esp::nav::PathFinder &pathfinder, PreparedReset &prepared)
+    {
+        step_ = 1;
+        num_resets_++;
+
+        episode_ = prepared.episode;
         position_ = episode_->startPosition;
         rotation_ = episode_->startRotation;
         goal_ = episode_->goal;
-        navmeshPosition_ = pathfinder.snapPoint(
-            Eigen::Map<const esp::vec3f>(glm::value_ptr(position_)));
+        navmeshPosition_ = prepared.navmeshStart;
+
+        if constexpr (SimulatorConfig::RECORD_TRACE) {
+            startTrace(pathfinder);
+        }
 
         updateObservationState();
 
-        StepInfo info = info_func_->reset(*this, pathfinder);
+        StepInfo info = info_func_->reset(*this, pathfinder, prepared.info);
         reward_func_->reset(*this, pathfinder, info);
     }
 
-    bool step(int64_t raw_action, esp::nav::PathFinder &pathfinder)
+    void speculateForward(esp::nav::PathFinder &pathfinder,
+                          Speculation &speculation) const
+    {
+        speculation.forwardPosition = tryMoveForward(pathfinder);
+        info_func_->speculateForward(*this, pathfinder,
+                                     speculation.forwardPosition,
+                                     speculation.info);
+    }
+
+    // speculation, if not null, must have been computed from the current
+    // pose
+    bool step(int64_t raw_action,
+              esp::nav::PathFinder &pathfinder,
+              const Speculation *speculation)
     {
         SimAction action {raw_action};
         step_++;
         bool done = step_ >= SimulatorConfig::MAX_STEPS;
         position_updated_ = false;
 
+        if (action != SimAction::MoveForward) {
+            speculation = nullptr;
+        }
+
         if (action == SimAction::Stop) {
             done = true;
         } else {
-            position_updated_ = handleMovement(action, pathfinder);
+            position_updated_ =
+                handleMovement(action, pathfinder, speculation);
             updateObservationState();
         }
 
-        StepInfo info = info_func_->step(*this, pathfinder, done);
+        if constexpr (SimulatorConfig::RECORD_TRACE) {
+            trace_.actions.push_back(static_cast<uint8_t>(action));
+            if (done) {
+                copy_n(navmeshPosition_.xyz.data(), 3, trace_.header.end);
+                trace_.header.numActions = trace_.actions.size();
+            }
+        }
+
+        StepInfo info = info_func_->step(
+            *this, pathfinder, done,
+            speculation != nullptr ? &speculation->info : nullptr);
 
         *outputs_.reward = reward_func_->step(*this, pathfinder, info, done);
         *outputs_.mask = done ? 0 : 1;
@@ -640,6 +1701,20 @@ public:
         return done;
     }
 
+    // Whether step(raw_action) will need navmesh queries or a reset, as
+    // opposed to just turning in place
+    bool isExpensiveStep(int64_t raw_action) const
+    {
+        SimAction action {raw_action};
+        return action == SimAction::Stop ||
+               action == SimAction::MoveForward ||
+               step_ + 1 >= SimulatorConfig::MAX_STEPS;
+    }
+
+    // The current episode up to the last step, complete once step returns
+    // true. Only recorded when built with BPS_SIM_RECORD_TRACE.
+    const RecordedEpisode &trace() const { return trace_; }
+
 private:
     enum class SimAction : int64_t {
         Stop = 0,
@@ -650,17 +1725,21 @@ private:
 
     inline void updateObservationState()
     {
-        // Update renderer view matrix (World -> Camera)
         glm::mat3 rot = glm::mat3_cast(rotation_);
         glm::mat3 transposed_rot = glm::transpose(rot);
-        glm::mat4 new_view(transposed_rot);
 
-        glm::vec3 eye_pos = position_ + SimulatorConfig::UP_VECTOR * 1.25f;
+        // Update renderer view matrix (World -> Camera)
+        if (render_env_ != nullptr) {
+            glm::mat4 new_view(transposed_rot);
+
+            glm::vec3 eye_pos =
+                position_ + SimulatorConfig::UP_VECTOR * 1.25f;
 
-        glm::vec4 translate(transposed_rot * -eye_pos, 1.f);
-        new_view[3] = translate;
+            glm::vec4 translate(transposed_rot * -eye_pos, 1.f);
+            new_view[3] = translate;
 
-        render_env_->setCameraView(new_view);
+            render_env_->setCameraView(new_view);
+        }
 
         // Write out polar coordinates
         glm::vec3 to_goal = goal_ - position_;
@@ -676,19 +1755,55 @@ private:
         *outputs_.polar = cartesianToPolar(-to_goal_view.z, to_goal_view.x);
     }
 
+    // Starts recording the episode reset began. The trace holds the goal
+    // snapped the way pathfinder_bench replays it, and the heading as the
+    // yaw it turns the forward vector by.
+    void startTrace(esp::nav::PathFinder &pathfinder)
+    {
+        QueryTraceEpisode &header = trace_.header;
+        header = {};
+
+        esp::nav::NavMeshPoint navmesh_goal = pathfinder.snapPoint(
+            Eigen::Map<const esp::vec3f>(glm::value_ptr(goal_)));
+
+        copy_n(glm::value_ptr(episode_->startPosition), 3,
+               header.requestedStart);
+        copy_n(glm::value_ptr(goal_), 3, header.requestedGoal);
+        copy_n(navmeshPosition_.xyz.data(), 3, header.start);
+        copy_n(navmesh_goal.xyz.data(), 3, header.goal);
+        header.startPoly = navmeshPosition_.polyId;
+        header.goalPoly = navmesh_goal.polyId;
+
+        glm::vec3 forward = glm::rotate(rotation_, glm::vec3(0.f, 0.f, -1.f));
+        header.startYaw = atan2f(-forward.x, -forward.z);
+
+        trace_.actions.clear();
+    }
+
+    inline esp::nav::NavMeshPoint tryMoveForward(
+        esp::nav::PathFinder &pathfinder) const
+    {
+        PhaseScope scope(Phase::TryStep);
+
+        glm::vec3 delta =
+            glm::rotate(rotation_, SimulatorConfig::CAM_FWD_VECTOR);
+        glm::vec3 new_pos = position_ + delta;
+
+        return pathfinder.tryStep(
+            navmeshPosition_,
+            Eigen::Map<const esp::vec3f>(glm::value_ptr(new_pos)));
+    }
+
     // Returns true when position updated
     inline bool handleMovement(SimAction action,
-                               esp::nav::PathFinder &pathfinder)
+                               esp::nav::PathFinder &pathfinder,
+                               const Speculation *speculation)
     {
         switch (action) {
             case SimAction::MoveForward: {
-                glm::vec3 delta =
-                    glm::rotate(rotation_, SimulatorConfig::CAM_FWD_VECTOR);
-                glm::vec3 new_pos = position_ + delta;
-
-                navmeshPosition_ = pathfinder.tryStep(
-                    navmeshPosition_,
-                    Eigen::Map<const esp::vec3f>(glm::value_ptr(new_pos)));
+                navmeshPosition_ = speculation != nullptr ?
+                                       speculation->forwardPosition :
+                                       tryMoveForward(pathfinder);
 
                 position_ = glm::make_vec3(navmeshPosition_.xyz.data());
                 return true;
@@ -715,6 +1830,9 @@ private:
     Span<const Episode> episodes_;
     Environment *render_env_;
     ResultPointers outputs_;
+    uint64_t seed_;
+    uint32_t env_id_;
+    uint32_t num_resets_;
     const Episode *episode_;
 
     glm::vec3 position_;
@@ -722,11 +1840,12 @@ private:
     glm::vec3 goal_;
 
     esp::nav::NavMeshPoint navmeshPosition_;
-    esp::nav::ShortestPath test_path_;
     bool position_updated_ = false;
 
     uint32_t step_;
 
+    RecordedEpisode trace_;
+
     RewardFunctor *reward_func_;
     InfoFunctor *info_func_;
 };
@@ -741,40 +1860,88 @@ struct InfoFunctor {
         float distanceToGoal;
     };
 
+    struct PreparedReset {
+        esp::nav::NavMeshPoint navmeshGoal;
+        float distanceToGoal;
+        esp::nav::DistanceField goalField;
+    };
+
+    static void prepareReset(const Episode &episode,
+                             const esp::nav::NavMeshPoint &navmesh_start,
+                             esp::nav::PathFinder &pathfinder,
+                             PreparedReset &prepared)
+    {
+        prepared.navmeshGoal = pathfinder.snapPoint(
+            Eigen::Map<const esp::vec3f>(glm::value_ptr(episode.goal)));
+
+        if constexpr (SimulatorConfig::GOAL_DISTANCE_FIELD) {
+            pathfinder.buildDistanceField(prepared.navmeshGoal,
+                                          prepared.goalField);
+            prepared.distanceToGoal =
+                pathfinder.geodesicDistance(prepared.goalField, navmesh_start);
+        } else {
+            prepared.distanceToGoal = computeGeoDist(
+                navmesh_start, prepared.navmeshGoal, pathfinder);
+        }
+    }
+
     StepInfo reset(BaseSimulator<RewardFunctor, InfoFunctor> &sim,
-                   esp::nav::PathFinder &pathfinder)
+                   esp::nav::PathFinder &,
+                   PreparedReset &prepared)
     {
-        navmeshGoal_ = pathfinder.snapPoint(
-            Eigen::Map<const esp::vec3f>(glm::value_ptr(sim.goal_)));
+        navmeshGoal_ = prepared.navmeshGoal;
         cumulative_travel_distance_ = 0;
-        initial_distance_to_goal_ = computeGeoDist(
-            sim.test_path_, sim.navmeshPosition_, navmeshGoal_, pathfinder);
+        if constexpr (SimulatorConfig::GOAL_CORRIDOR) {
+            goal_corridor_.reset();
+        }
+
+        // Swapping rather than copying keeps both fields' storage around
+        if constexpr (SimulatorConfig::GOAL_DISTANCE_FIELD) {
+            swap(goal_field_, prepared.goalField);
+        }
+        initial_distance_to_goal_ = prepared.distanceToGoal;
         prev_distance_to_goal_ = initial_distance_to_goal_;
         prev_position_ = sim.position_;
 
         return {0.0, 0.0, prev_distance_to_goal_};
     }
 
+    struct Speculation {
+        float distanceToGoal;
+    };
+
+    void speculateForward(const BaseSimulator<RewardFunctor, InfoFunctor> &,
+                          esp::nav::PathFinder &pathfinder,
+                          const esp::nav::NavMeshPoint &forward_position,
+                          Speculation &speculation) const
+    {
+        speculation.distanceToGoal =
+            distanceToGoal(forward_position, pathfinder);
+    }
+
     StepInfo step(BaseSimulator<RewardFunctor, InfoFunctor> &sim,
                   esp::nav::PathFinder &pathfinder,
-                  const bool done)
+                  const bool done,
+                  const Speculation *speculation)
     {
+        auto currentDistanceToGoal = [&]() {
+            return speculation != nullptr ?
+                       speculation->distanceToGoal :
+                       distanceToGoal(sim.navmeshPosition_, pathfinder);
+        };
+
         float distance_to_goal = 0;
         float success = 0;
         float spl = 0;
         if (done) {
-            distance_to_goal =
-                computeGeoDist(sim.test_path_, navmeshGoal_,
-                               sim.navmeshPosition_, pathfinder);
+            distance_to_goal = currentDistanceToGoal();
             success =
                 float(distance_to_goal < SimulatorConfig::SUCCESS_DISTANCE);
             spl = success * initial_distance_to_goal_ /
                   max(initial_distance_to_goal_, cumulative_travel_distance_);
         } else {
             if (sim.position_updated_) {
-                distance_to_goal =
-                    computeGeoDist(sim.test_path_, navmeshGoal_,
-                                   sim.navmeshPosition_, pathfinder);
+                distance_to_goal = currentDistanceToGoal();
 
                 cumulative_travel_distance_ +=
                     glm::length(sim.position_ - prev_position_);
@@ -789,12 +1956,30 @@ struct InfoFunctor {
         return {success, spl, distance_to_goal};
     }
 
+    inline float distanceToGoal(const esp::nav::NavMeshPoint &position,
+                                esp::nav::PathFinder &pathfinder) const
+    {
+        PhaseScope scope(Phase::Geodesic);
+
+        if constexpr (SimulatorConfig::GOAL_DISTANCE_FIELD) {
+            return pathfinder.geodesicDistance(goal_field_, position);
+        } else if constexpr (SimulatorConfig::GOAL_CORRIDOR) {
+            return pathfinder.geodesicDistance(goal_corridor_, position,
+                                               navmeshGoal_);
+        } else {
+            return computeGeoDist(navmeshGoal_, position, pathfinder);
+        }
+    }
+
     float prev_distance_to_goal_ = 0.0;
     float cumulative_travel_distance_ = 0.0;
     float initial_distance_to_goal_ = 0.0;
     glm::vec3 prev_position_;
 
     esp::nav::NavMeshPoint navmeshGoal_;
+    esp::nav::DistanceField goal_field_;
+    // Only caches the path to the goal, so const queries may patch it
+    mutable esp::nav::PathCorridor goal_corridor_;
 };
 
 struct RewardFunctor {
@@ -835,29 +2020,77 @@ struct InfoFunctor {
         float distanceFromStart;
     };
 
+    struct PreparedReset {
+        esp::nav::DistanceField startField;
+    };
+
+    static void prepareReset(const Episode &,
+                             const esp::nav::NavMeshPoint &navmesh_start,
+                             esp::nav::PathFinder &pathfinder,
+                             PreparedReset &prepared)
+    {
+        if constexpr (SimulatorConfig::START_DISTANCE_FIELD) {
+            pathfinder.buildDistanceField(navmesh_start, prepared.startField);
+        }
+    }
+
     StepInfo reset(BaseSimulator<RewardFunctor, InfoFunctor> &sim,
-                   esp::nav::PathFinder &)
+                   esp::nav::PathFinder &,
+                   PreparedReset &prepared)
     {
         navmeshStart_ = sim.navmeshPosition_;
         distance_from_start_ = 0.0;
+
+        if constexpr (SimulatorConfig::START_DISTANCE_FIELD) {
+            swap(start_field_, prepared.startField);
+        }
+
         return {distance_from_start_};
     }
 
+    struct Speculation {
+        float distanceFromStart;
+    };
+
+    void speculateForward(const BaseSimulator<RewardFunctor, InfoFunctor> &,
+                          esp::nav::PathFinder &pathfinder,
+                          const esp::nav::NavMeshPoint &forward_position,
+                          Speculation &speculation) const
+    {
+        speculation.distanceFromStart =
+            distanceFromStart(forward_position, pathfinder);
+    }
+
     StepInfo step(BaseSimulator<RewardFunctor, InfoFunctor> &sim,
                   esp::nav::PathFinder &pathfinder,
-                  const bool)
+                  const bool,
+                  const Speculation *speculation)
     {
         if (sim.position_updated_) {
             distance_from_start_ =
-                computeGeoDist(sim.test_path_, navmeshStart_,
-                               sim.navmeshPosition_, pathfinder);
+                speculation != nullptr ?
+                    speculation->distanceFromStart :
+                    distanceFromStart(sim.navmeshPosition_, pathfinder);
         }
 
         return {distance_from_start_};
     }
 
+    inline float distanceFromStart(const esp::nav::NavMeshPoint &position,
+                                   esp::nav::PathFinder &pathfinder) const
+    {
+        PhaseScope scope(Phase::Geodesic);
+
+        if constexpr (SimulatorConfig::START_DISTANCE_FIELD) {
+            return pathfinder.geodesicDistance(start_field_, position);
+        } else {
+            return computeGeoDist(navmeshStart_, position, pathfinder);
+        }
+    }
+
     float distance_from_start_;
     esp::nav::NavMeshPoint navmeshStart_;
+    esp::nav::DistanceField start_field_;
 };
 
 struct RewardFunctor {
@@ -889,6 +2122,64 @@ using Simulator = BaseSimulator<RewardFunctor, InfoFunctor>;
 namespace Exploration {
 struct RewardFunctor;
 
+// Set of visited cells, stored as a bitmap over a box of cells. Words are
+// cleared lazily: a word not written since the last reset is all zeros,
+// whatever its bits say, so resets don't touch the bitmap.
+class VisitedGrid {
+public:
+    // Starts a new empty set covering the cells from min_cell to max_cell,
+    // inclusive. Only allocates if the box is larger than any before it.
+    void reset(const glm::ivec3 &min_cell, const glm::ivec3 &max_cell)
+    {
+        min_cell_ = min_cell;
+        max_cell_ = max_cell;
+        dims_ = max_cell - min_cell + 1;
+
+        size_t num_cells = size_t(dims_.x) * dims_.y * dims_.z;
+        size_t num_words = (num_cells + 63) / 64;
+        if (num_words > words_.size()) {
+            words_.resize(num_words);
+            generations_.resize(num_words, generation_);
+        }
+
+        if (++generation_ == 0) {
+            fill(generations_.begin(), generations_.end(), 0);
+            generation_ = 1;
+        }
+        count_ = 0;
+    }
+
+    // Cells outside the box are clamped to its edge
+    void insert(const glm::ivec3 &cell)
+    {
+        glm::ivec3 offset = glm::clamp(cell, min_cell_, max_cell_) - min_cell_;
+        size_t idx =
+            (size_t(offset.z) * dims_.y + offset.y) * dims_.x + offset.x;
+
+        size_t word_idx = idx / 64;
+        uint64_t &word = words_[word_idx];
+        if (generations_[word_idx] != generation_) {
+            generations_[word_idx] = generation_;
+            word = 0;
+        }
+
+        uint64_t bit = uint64_t(1) << (idx % 64);
+        count_ += __builtin_popcountll(bit & ~word);
+        word |= bit;
+    }
+
+    uint32_t size() const { return count_; }
+
+private:
+    glm::ivec3 min_cell_ {};
+    glm::ivec3 max_cell_ {};
+    glm::ivec3 dims_ {};
+    vector<uint64_t> words_;
+    vector<uint32_t> generations_;
+    uint32_t generation_ = 0;
+    uint32_t count_ = 0;
+};
+
 struct InfoFunctor {
     struct StepInfo {
         float numVisited;
@@ -899,78 +2190,81 @@ struct InfoFunctor {
         glm::vec3 grid_pos = inverseInitialRotation_ *
                              (sim.position_ - initialPosition_) / cell_size_;
 
-        visited_set_.emplace(int(grid_pos.x), int(grid_pos.y),
-                             int(grid_pos.z));
+        visited_.insert(glm::ivec3(grid_pos));
     }
 
-    StepInfo reset(BaseSimulator<RewardFunctor, InfoFunctor> &sim,
-                   esp::nav::PathFinder &)
+    // Sizes the visited grid to hold every cell the navmesh's bounding box
+    // covers in the episode's frame, with a cell of padding for start
+    // positions that are slightly off the navmesh
+    void resetVisited(const esp::nav::PathFinder &pathfinder)
     {
-        visited_set_.clear();
+        auto [bounds_min, bounds_max] = pathfinder.bounds();
+        glm::vec3 world_min = glm::make_vec3(bounds_min.data());
+        glm::vec3 world_max = glm::make_vec3(bounds_max.data());
+
+        glm::mat3 rot = glm::mat3_cast(inverseInitialRotation_);
+        glm::mat3 abs_rot(glm::abs(rot[0]), glm::abs(rot[1]),
+                          glm::abs(rot[2]));
 
+        glm::vec3 center =
+            rot * ((world_min + world_max) * 0.5f - initialPosition_);
+        glm::vec3 half_extent = abs_rot * ((world_max - world_min) * 0.5f);
+
+        // Conversion truncates like update does, so the cells of the
+        // extreme points bound the cells of everything in between
+        visited_.reset(
+            glm::ivec3((center - half_extent) / cell_size_) - 1,
+            glm::ivec3((center + half_extent) / cell_size_) + 1);
+    }
+
+    struct PreparedReset {};
+
+    static void prepareReset(const Episode &,
+                             const esp::nav::NavMeshPoint &,
+                             esp::nav::PathFinder &,
+                             PreparedReset &)
+    {}
+
+    StepInfo reset(BaseSimulator<RewardFunctor, InfoFunctor> &sim,
+                   esp::nav::PathFinder &pathfinder,
+                   PreparedReset &)
+    {
         initialPosition_ = sim.position_;
         inverseInitialRotation_ = glm::inverse(sim.rotation_);
 
+        resetVisited(pathfinder);
         update(sim);
 
-        return {float(visited_set_.size() - 1)};
+        return {float(visited_.size() - 1)};
     }
 
+    // Marking cells visited needs no navmesh queries
+    struct Speculation {};
+
+    void speculateForward(const BaseSimulator<RewardFunctor, InfoFunctor> &,
+                          esp::nav::PathFinder &,
+                          const esp::nav::NavMeshPoint &,
+                          Speculation &) const
+    {}
+
     StepInfo step(BaseSimulator<RewardFunctor, InfoFunctor> &sim,
                   esp::nav::PathFinder &,
-                  const bool)
+                  const bool,
+                  const Speculation *)
     {
         if (sim.position_updated_) {
             update(sim);
         }
 
-        return {float(visited_set_.size() - 1)};
+        return {float(visited_.size() - 1)};
     }
 
-    constexpr static float cell_size_ = 1.0;
-
-    glm::vec3 initialPosition_;
-    glm::quat inverseInitialRotation_;
-
-    struct Hasher {
-        static size_t xorshift(const size_t &n, int i) { return n ^ (n >> i); }
-
-        static uint64_t hash(const uint64_t &n)
-        {
-            constexpr uint64_t p =
-                0x5555555555555555;  // pattern of alternating 0 and 1
-            constexpr uint64_t c =
-                17316035218449499591ull;  // random uneven integer constant;
-            return c * xorshift(p * xorshift(n, 32), 32);
-        }
-
-        template <typename T, typename S>
-        typename std::enable_if<std::is_unsigned<T>::value,
-                                T>::type constexpr static rotl(const T n,
-                                                               const S i)
-        {
-            const T m = (std::numeric_limits<T>::digits - 1);
-            const T c = i & m;
-            return (n << c) | (n >> ((T(0) - c) & m));
-        }
-
-        static inline size_t hash_combine(size_t &seed, const int &v)
-        {
-            return rotl(seed, std::numeric_limits<size_t>::digits / 3) ^
-                   hash(*reinterpret_cast<const unsigned int *>(&v));
-        }
+    constexpr static float cell_size_ = 1.0;
 
-        size_t operator()(const std::tuple<int, int, int> &v) const
-        {
-            size_t seed =
-                *reinterpret_cast<const unsigned int *>(&std::get<0>(v));
-            seed = hash_combine(seed, std::get<1>(v));
-            seed = hash_combine(seed, std::get<2>(v));
-            return seed;
-        }
-    };
+    glm::vec3 initialPosition_;
+    glm::quat inverseInitialRotation_;
 
-    std::unordered_set<std::tuple<int, int, int>, Hasher> visited_set_;
+    VisitedGrid visited_;
 };
 
 struct RewardFunctor {
@@ -1060,12 +2354,15 @@ static uint32_t computeNumWorkers(int num_desired_workers,
     return num_workers;
 }
 
+// The next scene is ready once its navmesh and, with a renderer, its render
+// assets are loaded.
 class SceneSwapper {
 public:
-    SceneSwapper(AssetLoader &&loader,
+    SceneSwapper(optional<AssetLoader> &&loader,
                  int background_loader_core_idx,
                  int background_loader_num_cores,
                  Dataset &dataset,
+                 NavmeshResidency &navmeshes,
                  uint32_t &active_scene,
                  std::vector<uint32_t> &inactive_scenes,
                  uint32_t envs_per_scene,
@@ -1074,21 +2371,29 @@ public:
           num_scene_loads_ {0},
           next_scene_future_ {},
           next_scene_ {},
-          loader_ {renderer_loader_, background_loader_core_idx,
-                   background_loader_num_cores},
+          next_scene_ready_ {false},
+          next_navmesh_future_ {},
+          loader_ {},
           dataset_ {dataset},
+          navmeshes_ {navmeshes},
           active_scene_ {active_scene},
+          retiring_scene_ {active_scene},
           inactive_scenes_ {inactive_scenes},
           envs_per_scene_ {envs_per_scene},
           rgen_ {rgen}
-    {}
+    {
+        if (renderer_loader_.has_value()) {
+            loader_.emplace(*renderer_loader_, background_loader_core_idx,
+                            background_loader_num_cores);
+        }
+    }
 
     SceneSwapper() = delete;
     SceneSwapper(const SceneSwapper &) = delete;
 
     bool canSwapScene() const
     {
-        return next_scene_ == nullptr && !next_scene_future_.valid();
+        return !next_scene_ready_ && !next_scene_future_.valid();
     }
 
     void startSceneSwap()
@@ -1100,28 +2405,46 @@ public:
 
             uint32_t new_scene_position = scene_selector(rgen_);
 
+            // Envs stay on the current scene until they swap
+            retiring_scene_ = active_scene_;
             swap(inactive_scenes_[new_scene_position], active_scene_);
 
-            auto scene_path = dataset_.getScenePath(active_scene_);
+            next_navmesh_future_ = navmeshes_.acquire(active_scene_);
 
-            next_scene_future_ = loader_.asyncLoadScene(scene_path);
+            if (loader_.has_value()) {
+                auto scene_path = dataset_.getScenePath(active_scene_);
+
+                next_scene_future_ = loader_->asyncLoadScene(scene_path);
+            }
         }
     }
 
     void preStep()
     {
-        if (next_scene_future_.isReady()) {
-            next_scene_ = next_scene_future_.get();
-            num_scene_loads_.store(envs_per_scene_, memory_order_relaxed);
+        if (next_navmesh_future_.isReady() &&
+            (!loader_.has_value() || next_scene_future_.isReady())) {
+            next_navmesh_future_.get();
+            navmeshes_.publish(active_scene_);
+
+            if (loader_.has_value()) {
+                next_scene_ = next_scene_future_.get();
+            }
+            markNextSceneReady();
         }
     }
 
     bool postStep()
     {
-        if (next_scene_ != nullptr &&
+        if (next_scene_ready_ &&
             num_scene_loads_.load(memory_order_relaxed) == 0) {
             next_scene_ = nullptr;
+            next_scene_ready_ = false;
+
+            // Released after picking the next scene, so a scene picked right
+            // back up doesn't get reloaded
+            uint32_t retired_scene = retiring_scene_;
             startSceneSwap();
+            navmeshes_.release(retired_scene);
             return true;
         }
 
@@ -1130,23 +2453,37 @@ public:
 
     void oneLoaded() { num_scene_loads_.fetch_sub(1, memory_order_relaxed); }
 
-    BackgroundSceneLoader &getLoader() { return loader_; }
+    BackgroundSceneLoader *getLoader()
+    {
+        return loader_.has_value() ? &*loader_ : nullptr;
+    }
+    bool nextSceneReady() const { return next_scene_ready_; }
     const shared_ptr<Scene> &getNextScene() const { return next_scene_; }
     atomic_uint32_t &getNumSceneLoads() { return num_scene_loads_; }
 
 private:
-    AssetLoader renderer_loader_;
+    void markNextSceneReady()
+    {
+        next_scene_ready_ = true;
+        num_scene_loads_.store(envs_per_scene_, memory_order_relaxed);
+    }
+
+    optional<AssetLoader> renderer_loader_;
 
     // Futures need to be destroyed before AssetLoader
     atomic_uint32_t num_scene_loads_;
     FastFuture<shared_ptr<Scene>> next_scene_future_;
     shared_ptr<Scene> next_scene_;
+    bool next_scene_ready_;
+    FastFuture<bool> next_navmesh_future_;
 
-    BackgroundSceneLoader loader_;
+    optional<BackgroundSceneLoader> loader_;
 
     Dataset &dataset_;
+    NavmeshResidency &navmeshes_;
 
     uint32_t &active_scene_;
+    uint32_t retiring_scene_;
     vector<uint32_t> &inactive_scenes_;
     uint32_t envs_per_scene_;
 
@@ -1177,24 +2514,36 @@ private:
     SceneSwapper *swapper_;
 };
 
+// renderer and loader are null when running without a renderer, in which
+// case no render environments are created
 template <class Simulator>
 class EnvironmentGroup {
 public:
-    EnvironmentGroup(Renderer &renderer,
-                     BackgroundSceneLoader &loader,
+    // The group's envs get ids first_env_id onwards, see BaseSimulator
+    EnvironmentGroup(Renderer *renderer,
+                     BackgroundSceneLoader *loader,
                      const Dataset &dataset,
                      uint32_t envs_per_scene,
                      const Span<const uint32_t> &initial_scene_indices,
-                     const Span<SceneSwapper> &scene_swappers)
+                     const Span<SceneSwapper> &scene_swappers,
+                     uint64_t seed,
+                     uint32_t first_env_id,
+                     QueryTraceRecorder *trace_recorder)
         : renderer_(renderer),
           dataset_(dataset),
+          trace_recorder_(trace_recorder),
           render_envs_(),
           sim_states_(),
           env_scenes_(),
           rewards_(envs_per_scene * initial_scene_indices.size()),
           masks_(rewards_.size()),
           infos_(rewards_.size()),
-          polars_(rewards_.size())
+          polars_(rewards_.size()),
+          prepared_(make_unique<PreparedSlot[]>(rewards_.size())),
+          speculations_(make_unique<SpeculationSlot[]>(rewards_.size())),
+          rollout_buffers_(),
+          rollout_buffer_owners_(),
+          rollout_step_(0)
     {
         render_envs_.reserve(rewards_.size());
         sim_states_.reserve(rewards_.size());
@@ -1206,16 +2555,26 @@ public:
             const uint32_t &scene_idx = initial_scene_indices[i];
             SceneSwapper &scene_swapper = scene_swappers[i];
 
-            auto scene_path = dataset_.getScenePath(scene_idx);
-            auto scene = loader.loadScene(scene_path);
+            shared_ptr<Scene> scene;
+            if (renderer_ != nullptr) {
+                auto scene_path = dataset_.getScenePath(scene_idx);
+                scene = loader->loadScene(scene_path);
+            }
 
             auto scene_episodes = dataset_.getEpisodes(scene_idx);
 
             for (uint32_t env_idx = 0; env_idx < envs_per_scene; env_idx++) {
-                render_envs_.emplace_back(
-                    renderer.makeEnvironment(scene, glm::mat4(1.f), 90.f, 0.f, 0.1, 1000));
-                sim_states_.emplace_back(scene_episodes, render_envs_.back(),
-                                         getPointers(sim_states_.size()));
+                Environment *render_env = nullptr;
+                if (renderer_ != nullptr) {
+                    render_envs_.emplace_back(
+                        renderer_->makeEnvironment(scene, glm::mat4(1.f), 90.f, 0.f, 0.1, 1000));
+                    render_env = &render_envs_.back();
+                }
+
+                sim_states_.emplace_back(
+                    scene_episodes, render_env,
+                    getPointers(sim_states_.size()), seed,
+                    first_env_id + sim_states_.size());
                 env_scenes_.emplace_back(&scene_idx, &scene_swapper);
             }
         }
@@ -1237,7 +2596,12 @@ public:
         return {num_scenes, avg_count};
     }
 
-    void render() { renderer_.render(render_envs_.data()); }
+    void render()
+    {
+        if (renderer_ != nullptr) {
+            renderer_->render(render_envs_.data());
+        }
+    }
 
     py::array_t<float> getRewards() const
     {
@@ -1261,6 +2625,71 @@ public:
                                   &polars_[0].x, py::none());
     }
 
+    // Has the envs' steps write straight into [T + 1, N] arrays, such as
+    // pinned rollout storage, rather than into the group's own vectors. Step
+    // t writes its reward and info to row t, and the mask and polar of the
+    // observation it produces to row t + 1. Resets started by
+    // RolloutGenerator::reset still write to the group's vectors. The arrays
+    // are kept alive for the life of the group.
+    void registerRolloutBuffers(py::array rewards,
+                                py::array masks,
+                                py::array infos,
+                                py::array polars)
+    {
+        const size_t num_slots = rewards.ndim() > 0 ? rewards.shape(0) : 0;
+        const size_t num_envs = sim_states_.size();
+        if (num_slots < 2) {
+            cerr << "Rollout buffers need at least 2 slots" << endl;
+            abort();
+        }
+
+        rollout_buffers_.emplace(RolloutBuffers {
+            checkedRolloutBuffer<float>(rewards, "rewards",
+                                        {num_slots, num_envs}),
+            checkedRolloutBuffer<uint8_t>(masks, "masks",
+                                          {num_slots, num_envs}),
+            checkedRolloutBuffer<typename Simulator::StepInfo>(
+                infos, "infos", {num_slots, num_envs}),
+            reinterpret_cast<glm::vec2 *>(checkedRolloutBuffer<float>(
+                polars, "polars", {num_slots, num_envs, 2})),
+            static_cast<uint32_t>(num_slots),
+        });
+        rollout_buffer_owners_ = {rewards, masks, infos, polars};
+        rollout_step_ = 0;
+    }
+
+    // The rollout step the group's next step writes. Each step moves it on
+    // by one, setting it back for the next rollout is up to the caller.
+    void setRolloutStep(uint32_t step)
+    {
+        if (!rollout_buffers_.has_value() ||
+            step + 1 >= rollout_buffers_->numSlots) {
+            cerr << "Rollout step " << step << " is outside the registered "
+                 << "rollout buffers" << endl;
+            abort();
+        }
+
+        rollout_step_ = step;
+    }
+
+    void startRolloutStep() const
+    {
+        if (rollout_buffers_.has_value() &&
+            rollout_step_ + 1 >= rollout_buffers_->numSlots) {
+            cerr << "Registered rollout buffers are full, the rollout step "
+                    "needs to be set back"
+                 << endl;
+            abort();
+        }
+    }
+
+    void finishRolloutStep()
+    {
+        if (rollout_buffers_.has_value()) {
+            rollout_step_++;
+        }
+    }
+
     ThreadEnvironment<Simulator> makeThreadEnv(uint32_t env_idx)
     {
         return ThreadEnvironment<Simulator>(env_idx, sim_states_[env_idx],
@@ -1271,31 +2700,150 @@ public:
                      vector<esp::nav::PathFinder> &pathfinders,
                      int64_t action)
     {
-        return env.sim_->step(action, pathfinders[env.scene_->curScene()]);
+        esp::nav::PathFinder &pathfinder =
+            pathfinders[env.scene_->curScene()];
+
+        if (rollout_buffers_.has_value()) {
+            env.sim_->setOutputs(getRolloutPointers(env.idx_));
+        }
+
+        if constexpr (SimulatorConfig::SPECULATE_FORWARD) {
+            SpeculationSlot &slot = speculations_[env.idx_];
+            bool speculated = acquireSlot(slot.state);
+
+            bool done = env.sim_->step(
+                action, pathfinder, speculated ? &slot.speculation : nullptr);
+
+            slot.state.store(SLOT_EMPTY, memory_order_release);
+
+            return done;
+        } else {
+            return env.sim_->step(action, pathfinder, nullptr);
+        }
     }
 
     inline void reset(const ThreadEnvironment<Simulator> &env,
-                      vector<esp::nav::PathFinder> &pathfinders,
-                      mt19937 &rgen)
+                      vector<esp::nav::PathFinder> &pathfinders)
+    {
+        acquireSlot(speculations_[env.idx_].state);
+        bool prepared = acquireSlot(prepared_[env.idx_].state);
+
+        if (rollout_buffers_.has_value()) {
+            env.sim_->setOutputs(getPointers(env.idx_));
+        }
+
+        resetAcquired(env, prepared, pathfinders);
+    }
+
+    // Starts env's next episode once the current one is done, moving it to
+    // the next scene first if there is one waiting
+    inline void endEpisode(ThreadEnvironment<Simulator> &env,
+                           vector<esp::nav::PathFinder> &pathfinders)
+    {
+        if constexpr (SimulatorConfig::RECORD_TRACE) {
+            trace_recorder_->add(env.scene_->curScene(), env.sim_->trace());
+        }
+
+        // Held across the swap, since speculating and preparing read the
+        // env's scene
+        acquireSlot(speculations_[env.idx_].state);
+        bool prepared = acquireSlot(prepared_[env.idx_].state);
+
+        if (swapReady(env)) {
+            swapScene(env);
+        }
+
+        resetAcquired(env, prepared, pathfinders);
+    }
+
+    // Fills the prepared reset of every env that doesn't have one, until
+    // should_stop returns true. Threads start at different envs so they
+    // don't all contend for the same slots.
+    template <typename StopFn>
+    void prepareResets(uint32_t thread_idx,
+                       uint32_t num_threads,
+                       vector<esp::nav::PathFinder> &pathfinders,
+                       StopFn &&should_stop)
+    {
+        const uint32_t num_envs = sim_states_.size();
+        const uint32_t first_env = thread_idx * num_envs / num_threads;
+
+        for (uint32_t i = 0; i < num_envs; i++) {
+            if (should_stop()) {
+                return;
+            }
+
+            uint32_t env_idx = (first_env + i) % num_envs;
+            PreparedSlot &slot = prepared_[env_idx];
+            if (!claimEmptySlot(slot.state)) {
+                continue;
+            }
+
+            slot.scene = env_scenes_[env_idx].curScene();
+            sim_states_[env_idx].prepareReset(pathfinders[slot.scene],
+                                              slot.reset);
+
+            slot.state.store(SLOT_READY, memory_order_release);
+        }
+    }
+
+    // Precomputes the result of MoveForward from every env's current pose,
+    // until should_stop returns true. Any step or reset of the env throws
+    // the result away.
+    template <typename StopFn>
+    void speculateForward(uint32_t thread_idx,
+                          uint32_t num_threads,
+                          vector<esp::nav::PathFinder> &pathfinders,
+                          StopFn &&should_stop)
     {
-        env.sim_->reset(pathfinders[env.scene_->curScene()], rgen);
+        const uint32_t num_envs = sim_states_.size();
+        const uint32_t first_env = thread_idx * num_envs / num_threads;
+
+        for (uint32_t i = 0; i < num_envs; i++) {
+            if (should_stop()) {
+                return;
+            }
+
+            uint32_t env_idx = (first_env + i) % num_envs;
+            SpeculationSlot &slot = speculations_[env_idx];
+            if (!claimEmptySlot(slot.state)) {
+                continue;
+            }
+
+            uint32_t scene_idx = env_scenes_[env_idx].curScene();
+            sim_states_[env_idx].speculateForward(pathfinders[scene_idx],
+                                                  slot.speculation);
+
+            slot.state.store(SLOT_READY, memory_order_release);
+        }
+    }
+
+    inline bool isExpensiveStep(const ThreadEnvironment<Simulator> &env,
+                                int64_t action) const
+    {
+        return env.sim_->isExpensiveStep(action);
     }
 
     bool swapReady(const ThreadEnvironment<Simulator> &env) const
     {
         const auto &scene_tracker = env_scenes_[env.idx_];
-        return scene_tracker.getSwapper().getNextScene() != nullptr &&
+        return scene_tracker.getSwapper().nextSceneReady() &&
                !scene_tracker.isConsistent();
     }
 
     void swapScene(ThreadEnvironment<Simulator> &env)
     {
+        PhaseScope scope(Phase::SwapScene);
+
         auto &scene_tracker = env_scenes_[env.idx_];
         SceneSwapper &swapper = scene_tracker.getSwapper();
-        shared_ptr<Scene> scene_data = swapper.getNextScene();
 
-        render_envs_[env.idx_] =
-            renderer_.makeEnvironment(move(scene_data), glm::mat4(1.f), 90.f, 0.f, 0.01, 1000);
+        if (renderer_ != nullptr) {
+            shared_ptr<Scene> scene_data = swapper.getNextScene();
+
+            render_envs_[env.idx_] =
+                renderer_->makeEnvironment(move(scene_data), glm::mat4(1.f), 90.f, 0.f, 0.01, 1000);
+        }
 
         scene_tracker.update();
         uint32_t scene_idx = scene_tracker.curScene();
@@ -1308,6 +2856,68 @@ public:
     }
 
 private:
+    // Per env slots for work done ahead of time by idle worker threads.
+    // Whoever moves a slot from EMPTY or READY to BUSY owns it until setting
+    // it back.
+    enum SlotState : uint32_t { SLOT_EMPTY, SLOT_BUSY, SLOT_READY };
+
+    // Owning this also gives access to the env's scene tracker and episode
+    // set
+    struct PreparedSlot {
+        atomic_uint32_t state {SLOT_EMPTY};
+        uint32_t scene;
+        typename Simulator::PreparedReset reset;
+    };
+
+    // Owning this also gives access to the env's pose and scene tracker, so
+    // the env is only stepped or reset while holding it
+    struct SpeculationSlot {
+        atomic_uint32_t state {SLOT_EMPTY};
+        typename Simulator::Speculation speculation;
+    };
+
+    // Returns whether the slot was READY. Waits out a worker that is still
+    // filling it, which takes a handful of navmesh queries.
+    static bool acquireSlot(atomic_uint32_t &state)
+    {
+        uint32_t cur = state.load(memory_order_relaxed);
+        while (true) {
+            if (cur == SLOT_BUSY) {
+                asm volatile("pause" ::: "memory");
+                cur = state.load(memory_order_relaxed);
+            } else if (state.compare_exchange_weak(cur, SLOT_BUSY,
+                                                   memory_order_acquire)) {
+                return cur == SLOT_READY;
+            }
+        }
+    }
+
+    static bool claimEmptySlot(atomic_uint32_t &state)
+    {
+        uint32_t cur = SLOT_EMPTY;
+        return state.load(memory_order_relaxed) == cur &&
+               state.compare_exchange_strong(cur, SLOT_BUSY,
+                                             memory_order_acquire);
+    }
+
+    void resetAcquired(const ThreadEnvironment<Simulator> &env,
+                       bool prepared,
+                       vector<esp::nav::PathFinder> &pathfinders)
+    {
+        PreparedSlot &slot = prepared_[env.idx_];
+        uint32_t scene_idx = env.scene_->curScene();
+        esp::nav::PathFinder &pathfinder = pathfinders[scene_idx];
+
+        // A reset prepared before a scene swap is for the old scene
+        if (!prepared || slot.scene != scene_idx) {
+            env.sim_->prepareReset(pathfinder, slot.reset);
+        }
+        env.sim_->reset(pathfinder, slot.reset);
+
+        slot.state.store(SLOT_EMPTY, memory_order_release);
+        speculations_[env.idx_].state.store(SLOT_EMPTY, memory_order_release);
+    }
+
     typename Simulator::ResultPointers getPointers(uint32_t idx)
     {
         return typename Simulator::ResultPointers {
@@ -1318,8 +2928,60 @@ private:
         };
     };
 
-    Renderer &renderer_;
+    typename Simulator::ResultPointers getRolloutPointers(uint32_t idx) const
+    {
+        const RolloutBuffers &buffers = *rollout_buffers_;
+        const size_t cur = size_t(rollout_step_) * sim_states_.size() + idx;
+        const size_t next = cur + sim_states_.size();
+
+        return typename Simulator::ResultPointers {
+            &buffers.rewards[cur],
+            &buffers.masks[next],
+            &buffers.infos[cur],
+            &buffers.polars[next],
+        };
+    }
+
+    // Checks buffer can be written in place as a C contiguous array of T
+    // with the given shape, so no converted copy is ever written instead
+    template <typename T>
+    static T *checkedRolloutBuffer(py::array &buffer,
+                                   const char *name,
+                                   const vector<size_t> &shape)
+    {
+        bool valid = py::isinstance<py::array_t<T, py::array::c_style>>(
+                         buffer) &&
+                     buffer.writeable() &&
+                     static_cast<size_t>(buffer.ndim()) == shape.size();
+        for (size_t i = 0; valid && i < shape.size(); i++) {
+            valid = static_cast<size_t>(buffer.shape(i)) == shape[i];
+        }
+
+        if (!valid) {
+            cerr << "Rollout buffer " << name << " must be a writeable, C "
+                 << "contiguous array of the step output type with shape [";
+            for (size_t i = 0; i < shape.size(); i++) {
+                cerr << (i > 0 ? ", " : "") << shape[i];
+            }
+            cerr << "]" << endl;
+            abort();
+        }
+
+        return static_cast<T *>(buffer.mutable_data());
+    }
+
+    // Slot major [numSlots, N] views of the registered arrays
+    struct RolloutBuffers {
+        float *rewards;
+        uint8_t *masks;
+        typename Simulator::StepInfo *infos;
+        glm::vec2 *polars;
+        uint32_t numSlots;
+    };
+
+    Renderer *renderer_;
     const Dataset &dataset_;
+    QueryTraceRecorder *trace_recorder_;
     vector<Environment> render_envs_;
     vector<Simulator> sim_states_;
     vector<SceneTracker> env_scenes_;
@@ -1327,6 +2989,11 @@ private:
     vector<uint8_t> masks_;
     vector<typename Simulator::StepInfo> infos_;
     vector<glm::vec2> polars_;
+    unique_ptr<PreparedSlot[]> prepared_;
+    unique_ptr<SpeculationSlot[]> speculations_;
+    optional<RolloutBuffers> rollout_buffers_;
+    vector<py::array> rollout_buffer_owners_;
+    uint32_t rollout_step_;
 };
 
 template <class Simulator>
@@ -1386,6 +3053,7 @@ public:
 
         auto action_raw = actions.unchecked<1>();
 
+        groups_[group_idx].startRolloutStep();
         simulateStart(group_idx, false, action_raw.data(0));
 
         num_steps_taken_ += actions.shape(0);
@@ -1394,6 +3062,7 @@ public:
     void stepEnd(uint32_t group_idx)
     {
         simulateEnd(group_idx);
+        groups_[group_idx].finishRolloutStep();
         for (auto &swapper : scene_swappers_)
             num_scenes_swapped_ += swapper.postStep() ? 1 : 0;
     };
@@ -1423,6 +3092,101 @@ public:
                 std::get<0>(groupStats), std::get<1>(groupStats)};
     }
 
+    // Load imbalance across simulation threads, measured as the busiest
+    // thread's time over the mean thread time (1 is perfectly balanced).
+    // Returns the value for the last simulated step and the mean over all
+    // steps so far.
+    std::tuple<float, float> schedulerStats() const
+    {
+        return {last_imbalance_,
+                num_imbalance_samples_ == 0 ?
+                    0.f :
+                    static_cast<float>(imbalance_sum_ /
+                                       num_imbalance_samples_)};
+    }
+
+    // Geodesic distance queries made so far, process wide, and the
+    // percentages of them answered by PathFinder's line of sight shortcut
+    // and by patching a path corridor instead of a path search
+    std::tuple<uint64_t, float, float> pathfinderStats() const
+    {
+        esp::nav::PathQueryStats stats = esp::nav::PathFinder::queryStats();
+
+        auto percentOfQueries = [&](uint64_t hits) {
+            return stats.queries == 0 ?
+                       0.f :
+                       static_cast<float>(static_cast<double>(hits) /
+                                          static_cast<double>(stats.queries) *
+                                          100.0);
+        };
+
+        return {stats.queries, percentOfQueries(stats.lineOfSightHits),
+                percentOfQueries(stats.corridorHits)};
+    }
+
+    // Per phase totals over every simulation thread since the last
+    // resetProfile: count, total ms, max ms, the log2 histogram of
+    // durations in ns described in PhaseProfiler, and total ms per thread
+    // with the main thread last. Empty unless built with BPS_SIM_PROFILE.
+    unordered_map<string,
+                  tuple<uint64_t, double, double, vector<uint64_t>,
+                        vector<double>>>
+    phaseStats() const
+    {
+        unordered_map<string, tuple<uint64_t, double, double,
+                                    vector<uint64_t>, vector<double>>>
+            result;
+
+        vector<PhaseProfiler::ThreadStats> thread_stats =
+            profiler_.threadStats();
+        if (thread_stats.empty()) {
+            return result;
+        }
+
+        for (size_t phase = 0; phase < PHASE_NAMES.size(); phase++) {
+            uint64_t count = 0, total_ns = 0, max_ns = 0;
+            vector<uint64_t> buckets(PhaseProfiler::NUM_BUCKETS, 0);
+            vector<double> thread_ms;
+            thread_ms.reserve(thread_stats.size());
+
+            for (const PhaseProfiler::ThreadStats &stats : thread_stats) {
+                const PhaseProfiler::PhaseStats &phase_stats = stats[phase];
+                count += phase_stats.count;
+                total_ns += phase_stats.totalNs;
+                max_ns = max(max_ns, phase_stats.maxNs);
+                for (uint32_t b = 0; b < buckets.size(); b++) {
+                    buckets[b] += phase_stats.buckets[b];
+                }
+                thread_ms.push_back(phase_stats.totalNs / 1e6);
+            }
+
+            result.emplace(PHASE_NAMES[phase],
+                           make_tuple(count, total_ns / 1e6, max_ns / 1e6,
+                                      move(buckets), move(thread_ms)));
+        }
+
+        return result;
+    }
+
+    // Writes the most recent phase events of every simulation thread as a
+    // Chrome trace, see PhaseProfiler::writeChromeTrace
+    bool exportTrace(const string &path) const
+    {
+        return profiler_.writeChromeTrace(path);
+    }
+
+    void resetProfile() { profiler_.clear(); }
+
+    // Writes the episodes envs finished since the last resetQueryTraces as
+    // pathfinder_bench query traces, see QueryTraceRecorder. There are none
+    // unless built with BPS_SIM_RECORD_TRACE.
+    bool exportQueryTraces(const string &dir) const
+    {
+        return trace_recorder_.write(dir, dataset_);
+    }
+
+    void resetQueryTraces() { trace_recorder_.clear(); }
+
     py::array_t<float> getRewards(uint32_t group_idx) const
     {
         return groups_[group_idx].getRewards();
@@ -1444,19 +3208,47 @@ public:
         return groups_[group_idx].getPolars();
     }
 
+    // See EnvironmentGroup::registerRolloutBuffers. The arrays returned by
+    // getRewards and co. stop seeing the group's step results once
+    // registered.
+    void registerRolloutBuffers(uint32_t group_idx,
+                                py::array rewards,
+                                py::array masks,
+                                py::array infos,
+                                py::array polars)
+    {
+        groups_[group_idx].registerRolloutBuffers(rewards, masks, infos,
+                                                  polars);
+    }
+
+    void setRolloutStep(uint32_t group_idx, uint32_t step)
+    {
+        groups_[group_idx].setRolloutStep(step);
+    }
+
     py::capsule getColorMemory(const uint32_t groupIdx)
     {
-        return py::capsule(renderer_.getColorPointer(groupIdx));
+        if (!renderer_.has_value()) {
+            return py::capsule(nullptr);
+        }
+
+        return py::capsule(renderer_->getColorPointer(groupIdx));
     }
 
     py::capsule getDepthMemory(const uint32_t groupIdx)
     {
-        return py::capsule(renderer_.getDepthPointer(groupIdx));
+        if (!renderer_.has_value()) {
+            return py::capsule(nullptr);
+        }
+
+        return py::capsule(renderer_->getDepthPointer(groupIdx));
     }
 
     void waitForFrame(const uint32_t groupIdx)
     {
-        renderer_.waitForFrame(groupIdx);
+        if (renderer_.has_value()) {
+            renderer_->waitForFrame(groupIdx);
+        }
     }
 
 private:
@@ -1473,19 +3265,14 @@ private:
                      uint64_t seed,
                      bool should_set_affinity)
         : dataset_(dataset_path, asset_path, num_workers),
-          renderer_(makeRenderer(gpu_id,
-                                 num_environments / num_groups,
-                                 num_active_scenes,
-                                 render_resolution,
-                                 color,
-                                 depth,
-                                 num_groups == 2)),
+          renderer_(),
           envs_per_scene_(num_environments / num_active_scenes),
           envs_per_group_(num_environments / num_groups),
           active_scenes_(),
           inactive_scenes_(),
           rgen_(seed),
           scene_swappers_(num_active_scenes),
+          navmeshes_(dataset_, asset_path),
           groups_(),
           thread_envs_(),
           main_thread_pathfinders_(),
@@ -1495,6 +3282,11 @@ private:
           start_atomic_(),
           workers_finished_(1 + num_workers),
           next_env_queue_(0),
+          worker_queues_(make_unique<WorkerQueue[]>(1 + num_workers)),
+          profiler_(SimulatorConfig::PROFILE ? 1 + num_workers : 0),
+          trace_recorder_(),
+          env_order_(),
+          sorted_envs_(),
           active_group_(),
           active_actions_(nullptr),
           sim_reset_(false),
@@ -1507,8 +3299,18 @@ private:
             abort();
         }
 
+        // With no color or depth output there is nothing to render, so run
+        // headless: no GPU is needed and no render assets are loaded
+        if (color || depth) {
+            renderer_.emplace(makeRenderConfig(
+                gpu_id, num_environments / num_groups, num_active_scenes,
+                render_resolution, color, depth, num_groups == 2));
+        }
+
         groups_.reserve(num_groups);
         worker_threads_.reserve(num_workers);
+        env_order_.resize(envs_per_group_);
+        sorted_envs_.resize(envs_per_group_);
 
         active_scenes_.reserve(num_active_scenes);
         inactive_scenes_.reserve(dataset_.numScenes() - num_active_scenes);
@@ -1533,6 +3335,8 @@ private:
             inactive_scenes_.push_back(scene_idx);
         }
 
+        navmeshes_.loadScenes(active_scenes_, num_workers);
+
         assert(num_environments % num_groups == 0);
         assert(num_environments % num_active_scenes == 0);
         assert(num_active_scenes % num_groups == 0);
@@ -1569,10 +3373,15 @@ private:
                 }
             }
 
+            optional<AssetLoader> scene_loader;
+            if (renderer_.has_value()) {
+                scene_loader.emplace(renderer_->makeLoader());
+            }
+
             new (&scene_swappers_[i]) SceneSwapper(
-                renderer_.makeLoader(), core_idx, num_scene_loader_cores,
-                dataset_, active_scenes_[i], inactive_scenes_, envs_per_scene_,
-                rgen_);
+                move(scene_loader), core_idx, num_scene_loader_cores,
+                dataset_, navmeshes_, active_scenes_[i], inactive_scenes_,
+                envs_per_scene_, rgen_);
         }
 
         uint32_t scenes_per_group = num_active_scenes / num_groups;
@@ -1580,12 +3389,14 @@ private:
 
         for (uint32_t i = 0; i < num_groups; i++) {
             groups_.emplace_back(
-                renderer_, scene_swappers_[0].getLoader(), dataset_,
+                renderer_.has_value() ? &*renderer_ : nullptr,
+                scene_swappers_[0].getLoader(), dataset_,
                 envs_per_scene_,
                 Span<const uint32_t>(&active_scenes_[i * scenes_per_group],
                                      scenes_per_group),
                 Span(&scene_swappers_[i * scenes_per_group],
-                     scenes_per_group));
+                     scenes_per_group),
+                seed, i * envs_per_group_, &trace_recorder_);
             for (uint32_t env_idx = 0; env_idx < envs_per_group_; env_idx++) {
                 thread_envs_.emplace_back(groups_[i].makeThreadEnv(env_idx));
             }
@@ -1600,8 +3411,8 @@ private:
                                (1 + (thread_idx % num_worker_cores)) :
                                -1;
 
-            worker_threads_.emplace_back([this, seed, thread_idx, core_idx]() {
-                simulationWorker(seed + 1 + thread_idx, core_idx);
+            worker_threads_.emplace_back([this, thread_idx, core_idx]() {
+                simulationWorker(thread_idx, core_idx);
             });
         }
 
@@ -1612,37 +3423,94 @@ private:
 
         main_thread_pathfinders_ = initPathfinders();
 
+        if constexpr (SimulatorConfig::PROFILE) {
+            profiler_.attachThread(num_workers);
+        }
+
         // Wait for all threads to reach the start of the their work loop.
         pthread_barrier_wait(&ready_barrier_);
     }
 
-    inline bool simulate(vector<esp::nav::PathFinder> &thread_pathfinders,
-                         mt19937 &rgen)
+    // Scheduling state for one simulation thread, the main thread is last.
+    // Only the busy time is used without work stealing. Also tracks which
+    // navmeshes the thread's PathFinders were last synced to.
+    struct alignas(64) WorkerQueue {
+        atomic_uint32_t next;
+        uint32_t expensiveEnd;
+        uint32_t end;
+        uint64_t busyNs;
+        uint64_t navmeshEpoch;
+    };
+
+    inline void simulateEnv(EnvironmentGroup<Simulator> &group,
+                            uint32_t env_idx,
+                            bool trigger_reset,
+                            vector<esp::nav::PathFinder> &thread_pathfinders)
+    {
+        ThreadEnvironment<Simulator> &env =
+            thread_envs_[env_idx + active_group_ * envs_per_group_];
+
+        if (trigger_reset) {
+            PhaseScope scope(Phase::Reset);
+            group.reset(env, thread_pathfinders);
+        } else {
+            bool done;
+            {
+                PhaseScope scope(Phase::Step);
+                done = group.step(env, thread_pathfinders,
+                                  active_actions_[env_idx]);
+            }
+
+            if (done) {
+                PhaseScope scope(Phase::Reset);
+                group.endEpisode(env, thread_pathfinders);
+            }
+        }
+    }
+
+    inline bool simulate(uint32_t thread_idx,
+                         vector<esp::nav::PathFinder> &thread_pathfinders)
     {
+        auto start = chrono::steady_clock::now();
+        PhaseScope scope(Phase::Simulate);
+
+        navmeshes_.syncPathfinders(thread_pathfinders,
+                                   worker_queues_[thread_idx].navmeshEpoch);
+
         const bool trigger_reset = sim_reset_;
         EnvironmentGroup<Simulator> &group = groups_[active_group_];
 
-        uint32_t next_env;
-        while ((next_env = next_env_queue_.fetch_add(
-                    1, memory_order_acq_rel)) < envs_per_group_) {
-            ThreadEnvironment<Simulator> &env =
-                thread_envs_[next_env + active_group_ * envs_per_group_];
+        if constexpr (SimulatorConfig::WORK_STEALING) {
+            const uint32_t num_threads = worker_threads_.size() + 1;
 
-            if (trigger_reset) {
-                group.reset(env, thread_pathfinders, rgen);
-            } else {
-                bool done = group.step(env, thread_pathfinders,
-                                       active_actions_[next_env]);
-                if (done) {
-                    if (group.swapReady(env)) {
-                        group.swapScene(env);
-                    }
+            // Drain this thread's own range, then steal from the others.
+            // Ranges only ever shrink, so one pass over them is enough.
+            for (uint32_t offset = 0; offset < num_threads; offset++) {
+                WorkerQueue &queue =
+                    worker_queues_[(thread_idx + offset) % num_threads];
 
-                    group.reset(env, thread_pathfinders, rgen);
+                uint32_t begin, end;
+                while (claimEnvs(queue, offset == 0, begin, end)) {
+                    for (uint32_t i = begin; i < end; i++) {
+                        simulateEnv(group, env_order_[i], trigger_reset,
+                                    thread_pathfinders);
+                    }
                 }
             }
+        } else {
+            uint32_t next_env;
+            while ((next_env = next_env_queue_.fetch_add(
+                        1, memory_order_acq_rel)) < envs_per_group_) {
+                simulateEnv(group, next_env, trigger_reset,
+                            thread_pathfinders);
+            }
         }
 
+        worker_queues_[thread_idx].busyNs =
+            chrono::duration_cast<chrono::nanoseconds>(
+                chrono::steady_clock::now() - start)
+                .count();
+
         // Returns true to a thread when this iteration is done. Used as small
         // optimization to avoid extra load when main thread finishes last.
         // worker_threads_.size() is equal to the value that this needs to
@@ -1652,6 +3520,112 @@ private:
                worker_threads_.size();
     }
 
+    // Claims the next chunk [begin, end) of env_order_ from queue. Expensive
+    // envs are always claimed one at a time so they spread across threads,
+    // cheap envs in chunks proportional to what is left in the range.
+    static bool claimEnvs(WorkerQueue &queue,
+                          bool owner,
+                          uint32_t &begin,
+                          uint32_t &end)
+    {
+        uint32_t cur = queue.next.load(memory_order_relaxed);
+        while (cur < queue.end) {
+            uint32_t chunk = 1;
+            if (cur >= queue.expensiveEnd) {
+                uint32_t divisor = owner ?
+                                       SimulatorConfig::OWNER_CHUNK_DIVISOR :
+                                       SimulatorConfig::STEAL_CHUNK_DIVISOR;
+                chunk = max(1u, (queue.end - cur) / divisor);
+            }
+
+            if (queue.next.compare_exchange_weak(cur, cur + chunk,
+                                                 memory_order_relaxed)) {
+                begin = cur;
+                end = cur + chunk;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Deals the active group's envs out round robin into one contiguous
+    // range of env_order_ per thread, known expensive envs first. Each
+    // thread starts on its share of the expensive work, and the cheap envs
+    // at the tail of each range are what gets stolen.
+    void scheduleEnvs(bool trigger_reset)
+    {
+        const uint32_t num_threads = worker_threads_.size() + 1;
+        const EnvironmentGroup<Simulator> &group = groups_[active_group_];
+
+        // Resets all cost about the same, so there is nothing to sort
+        uint32_t num_expensive = 0;
+        if (!trigger_reset) {
+            uint32_t num_cheap = 0;
+            for (uint32_t env_idx = 0; env_idx < envs_per_group_;
+                 env_idx++) {
+                const ThreadEnvironment<Simulator> &env =
+                    thread_envs_[env_idx + active_group_ * envs_per_group_];
+
+                if (group.isExpensiveStep(env, active_actions_[env_idx])) {
+                    sorted_envs_[num_expensive++] = env_idx;
+                } else {
+                    sorted_envs_[envs_per_group_ - ++num_cheap] = env_idx;
+                }
+            }
+        } else {
+            for (uint32_t env_idx = 0; env_idx < envs_per_group_;
+                 env_idx++) {
+                sorted_envs_[env_idx] = env_idx;
+            }
+        }
+
+        uint32_t range_start = 0;
+        for (uint32_t thread_idx = 0; thread_idx < num_threads;
+             thread_idx++) {
+            WorkerQueue &queue = worker_queues_[thread_idx];
+
+            uint32_t range_size = 0;
+            for (uint32_t i = thread_idx; i < envs_per_group_;
+                 i += num_threads) {
+                env_order_[range_start + range_size++] = sorted_envs_[i];
+            }
+
+            uint32_t expensive_size =
+                num_expensive > thread_idx ?
+                    (num_expensive - thread_idx + num_threads - 1) /
+                        num_threads :
+                    0;
+
+            queue.next.store(range_start, memory_order_relaxed);
+            queue.expensiveEnd = range_start + expensive_size;
+            queue.end = range_start + range_size;
+
+            range_start += range_size;
+        }
+    }
+
+    void updateImbalance()
+    {
+        const uint32_t num_threads = worker_threads_.size() + 1;
+
+        uint64_t total_ns = 0;
+        uint64_t max_ns = 0;
+        for (uint32_t i = 0; i < num_threads; i++) {
+            total_ns += worker_queues_[i].busyNs;
+            max_ns = max(max_ns, worker_queues_[i].busyNs);
+        }
+
+        if (total_ns == 0) {
+            return;
+        }
+
+        last_imbalance_ = static_cast<float>(
+            static_cast<double>(max_ns) * num_threads / total_ns);
+        imbalance_sum_ += last_imbalance_;
+        num_imbalance_samples_++;
+    }
+
     void simulateStart(uint32_t active_group,
                        bool trigger_reset,
                        const int64_t *action_ptr)
@@ -1665,7 +3639,11 @@ private:
         active_actions_ = action_ptr;
         sim_reset_ = trigger_reset;
 
-        next_env_queue_.store(0, memory_order_relaxed);
+        if constexpr (SimulatorConfig::WORK_STEALING) {
+            scheduleEnvs(trigger_reset);
+        } else {
+            next_env_queue_.store(0, memory_order_relaxed);
+        }
         workers_finished_.store(0, memory_order_relaxed);
 
         atomic_thread_fence(memory_order_release);
@@ -1688,8 +3666,10 @@ private:
             abort();
         }
 
-        bool finished = simulate(main_thread_pathfinders_, rgen_);
+        bool finished =
+            simulate(worker_threads_.size(), main_thread_pathfinders_);
         if (!finished) {
+            PhaseScope scope(Phase::MainSpin);
             while (workers_finished_.load(memory_order_acquire) !=
                    wait_target_) {
                 asm volatile("pause" ::: "memory");
@@ -1697,6 +3677,8 @@ private:
         }
 
         atomic_thread_fence(memory_order_acquire);
+
+        updateImbalance();
     }
 
     void simulateAndRender(uint32_t active_group,
@@ -1709,52 +3691,69 @@ private:
         render(active_group);
     }
 
+    // Per-thread PathFinders only reference the navmeshes in navmeshes_,
+    // they don't load their own copy. They are attached to the resident
+    // navmeshes at the start of every simulate.
     vector<esp::nav::PathFinder> initPathfinders()
     {
-        vector<esp::nav::PathFinder> pathfinders(dataset_.numScenes());
-
-        for (uint32_t scene_idx = 0; scene_idx < dataset_.numScenes();
-             scene_idx++) {
-            auto navmesh_path = dataset_.getNavmeshPath(scene_idx);
-
-            bool navmesh_success =
-                pathfinders[scene_idx].loadNavMesh(string(navmesh_path));
-
-            if (!navmesh_success) {
-                cerr << "Failed to load navmesh: " << navmesh_path << endl;
-                abort();
-            }
-        }
-
-        return pathfinders;
+        return vector<esp::nav::PathFinder>(dataset_.numScenes());
     }
 
-    void simulationWorker(uint64_t seed, int core_idx)
+    void simulationWorker(uint32_t thread_idx, int core_idx)
     {
         set_affinity(core_idx);
 
-        mt19937 rgen(seed);
-
         vector<esp::nav::PathFinder> thread_pathfinders = initPathfinders();
 
+        if constexpr (SimulatorConfig::PROFILE) {
+            profiler_.attachThread(thread_idx);
+        }
+
         pthread_barrier_wait(&ready_barrier_);
 
         uint32_t wait_val = 0;
         while (true) {
-            atomic_wait_explicit(&start_atomic_, wait_val,
-                                 memory_order_acquire);
+            {
+                PhaseScope scope(Phase::WorkerWait);
+                atomic_wait_explicit(&start_atomic_, wait_val,
+                                     memory_order_acquire);
+            }
             wait_val ^= 1;
 
             if (exit_) {
                 return;
             }
 
-            simulate(thread_pathfinders, rgen);
+            // Read before signalling completion in simulate, after which the
+            // main thread is free to start another step
+            uint32_t group_idx = active_group_;
+
+            simulate(thread_idx, thread_pathfinders);
+
+            // Use the time until the next step starts to get ahead on the
+            // envs just simulated
+            auto next_step_started = [this, wait_val]() {
+                return start_atomic_.load(memory_order_relaxed) != wait_val;
+            };
+
+            if constexpr (SimulatorConfig::SPECULATE_FORWARD) {
+                PhaseScope scope(Phase::SpeculateForward);
+                groups_[group_idx].speculateForward(
+                    thread_idx, worker_threads_.size(), thread_pathfinders,
+                    next_step_started);
+            }
+
+            if constexpr (SimulatorConfig::RESET_AHEAD) {
+                PhaseScope scope(Phase::PrepareResets);
+                groups_[group_idx].prepareResets(
+                    thread_idx, worker_threads_.size(), thread_pathfinders,
+                    next_step_started);
+            }
         }
     }
 
     Dataset dataset_;
-    Renderer renderer_;
+    optional<Renderer> renderer_;
     uint32_t envs_per_scene_;
     uint32_t envs_per_group_;
     vector<uint32_t> active_scenes_;
@@ -1762,6 +3761,8 @@ private:
 
     mt19937 rgen_;
     DynArray<SceneSwapper> scene_swappers_;
+    // Destroyed before the swappers, whose futures it may still be filling
+    NavmeshResidency navmeshes_;
     vector<EnvironmentGroup<Simulator>> groups_;
     vector<ThreadEnvironment<Simulator>> thread_envs_;
     vector<esp::nav::PathFinder> main_thread_pathfinders_;
@@ -1773,6 +3774,11 @@ private:
     atomic_uint32_t workers_finished_;
 
     atomic_uint32_t next_env_queue_;
+    unique_ptr<WorkerQueue[]> worker_queues_;
+    PhaseProfiler profiler_;
+    QueryTraceRecorder trace_recorder_;
+    vector<uint32_t> env_order_;
+    vector<uint32_t> sorted_envs_;
     uint32_t active_group_;
     const int64_t *active_actions_;
     bool sim_reset_;
@@ -1780,6 +3786,10 @@ private:
 
     uint64_t num_steps_taken_ = 0;
     uint64_t num_scenes_swapped_ = 0;
+
+    float last_imbalance_ = 0;
+    double imbalance_sum_ = 0;
+    uint64_t num_imbalance_samples_ = 0;
 };
 
 template <class Simulator>
@@ -1806,7 +3816,16 @@ void make_rollout_gen(py::module &m, const std::string &name)
         .def("get_masks", &RG::getMasks)
         .def("get_infos", &RG::getInfos)
         .def("get_polars", &RG::getPolars)
-        .def_property_readonly("swap_stats", &RG::swapStats);
+        .def("register_rollout_buffers", &RG::registerRolloutBuffers)
+        .def("set_rollout_step", &RG::setRolloutStep)
+        .def("export_trace", &RG::exportTrace)
+        .def("reset_profile", &RG::resetProfile)
+        .def("export_query_traces", &RG::exportQueryTraces)
+        .def("reset_query_traces", &RG::resetQueryTraces)
+        .def_property_readonly("phase_stats", &RG::phaseStats)
+        .def_property_readonly("swap_stats", &RG::swapStats)
+        .def_property_readonly("scheduler_stats", &RG::schedulerStats)
+        .def_property_readonly("pathfinder_stats", &RG::pathfinderStats);
 }
 
 PYBIND11_MODULE(bps_sim, m)
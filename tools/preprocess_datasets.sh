@@ -9,10 +9,12 @@ done
 mkdir textures
 mv data/scene_datasets/gibson/*jpg textures/
 
-[ ! -d "data/scene_datasets/mp3d" ] && exit
+if [ -d "data/scene_datasets/mp3d" ]; then
+    for x in `find data/scene_datasets/mp3d/ -name '*glb'`; do
+        dir="`dirname $x`"
 
-for x in `find data/scene_datasets/mp3d/ -name '*glb'`; do
-    dir="`dirname $x`"
+        ./simulator/python/bps_sim/preprocess $x $dir/`basename $x .glb`.bps right backward up $dir
+    done
+fi
 
-    ./simulator/python/bps_sim/preprocess $x $dir/`basename $x .glb`.bps right backward up $dir
-done
+./simulator/python/bps_sim/pack_navmeshes data/scene_datasets